@@ -0,0 +1,222 @@
+﻿/*******************************************************************************
+* Copyright 2016 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM */
+
+// Float vs double benchmark. CMake builds this file twice, against a float
+// and a double copy of the library, as robotis_manipulator_benchmark_float
+// and robotis_manipulator_benchmark_double. Run both and compare.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "robotis_manipulator/robotis_manipulator.h"
+
+using namespace ROBOTIS_MANIPULATOR;
+
+#define WORLD 0
+#define COMP1 1
+#define COMP2 2
+#define COMP3 3
+#define COMP4 4
+#define TOOL 5
+
+#define FK_CONFIGURATION_NUM 4000
+#define TICK_NUM 100000
+#define LONG_MOVE_TIME 600.0
+
+class NullActuator : public Actuator
+{
+public:
+  void initActuator(const void * /*arg*/) {}
+  void setActuatorControlMode() {}
+  void Enable() {}
+  void Disable() {}
+  bool sendAllActuatorAngle(std::vector<double> /*radian_vector*/) { return true; }
+  bool writeAllActuatorAngle(const std::vector<double> & /*radian_vector*/) { return true; }
+  bool sendMultipleActuatorAngle(std::vector<uint8_t> /*id*/, std::vector<double> /*radian_vector*/) { return true; }
+  bool sendActuatorAngle(uint8_t /*actuator_id*/, double /*radian*/) { return true; }
+  bool sendActuatorSignal(uint8_t /*actuator_id*/, bool /*onoff*/) { return true; }
+  std::vector<double> receiveAllActuatorAngle(void) { return std::vector<double>(4, 0.0); }
+};
+
+static const double g_offset[4][3] = {{-0.278, 0.0, 0.017}, {0.0, 0.0, 0.058}, {0.024, 0.0, 0.128}, {0.124, 0.0, 0.0}};
+static const double g_axis[4][3] = {{0.0, 0.0, 1.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 1.0, 0.0}};
+static const double g_tool_offset[3] = {0.126, 0.0, 0.0};
+
+static double getTime()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void build(RobotisManipulator *manipulator)
+{
+  Name name[5] = {COMP1, COMP2, COMP3, COMP4, TOOL};
+
+  manipulator->addWorld(WORLD, COMP1);
+  for (uint8_t index = 0; index < 4; index++)
+  {
+    manipulator->addComponent(name[index], (index == 0) ? WORLD : name[index - 1], name[index + 1],
+                              RM_MATH::makeVector3(g_offset[index][0], g_offset[index][1], g_offset[index][2]),
+                              IDENTITY_MATRIX,
+                              RM_MATH::makeVector3(g_axis[index][0], g_axis[index][1], g_axis[index][2]),
+                              index + 1);
+  }
+  manipulator->addTool(TOOL, COMP4, RM_MATH::makeVector3(g_tool_offset[0], g_tool_offset[1], g_tool_offset[2]), IDENTITY_MATRIX, 5);
+  manipulator->checkManipulatorSetting();
+}
+
+// Tool pose in double, independent of the library's scalar type
+static void referenceForward(const double *angle, Eigen::Vector3d *position, Eigen::Matrix3d *orientation)
+{
+  position->setZero();
+  orientation->setIdentity();
+  for (uint8_t index = 0; index < 4; index++)
+  {
+    *position += *orientation * Eigen::Vector3d(g_offset[index][0], g_offset[index][1], g_offset[index][2]);
+    *orientation = *orientation * Eigen::AngleAxisd(angle[index], Eigen::Vector3d(g_axis[index][0], g_axis[index][1], g_axis[index][2])).toRotationMatrix();
+  }
+  *position += *orientation * Eigen::Vector3d(g_tool_offset[0], g_tool_offset[1], g_tool_offset[2]);
+}
+
+static void benchmarkForward()
+{
+  RobotisManipulator manipulator;
+  build(&manipulator);
+
+  MatrixXr joint_angle(FK_CONFIGURATION_NUM, 4);
+  for (uint32_t row = 0; row < FK_CONFIGURATION_NUM; row++)
+  {
+    for (uint8_t col = 0; col < 4; col++)
+      joint_angle(row, col) = Real(1.5 * sin(0.37 * row + 1.3 * col));
+  }
+
+  MatrixXr tool_position, tool_orientation;
+  double start = getTime();
+  manipulator.forward(TOOL, joint_angle, &tool_position, &tool_orientation);
+  double batch_time = getTime() - start;
+
+  double error = 0.0;
+  for (uint32_t row = 0; row < FK_CONFIGURATION_NUM; row++)
+  {
+    double angle[4];
+    Eigen::Vector3d position;
+    Eigen::Matrix3d orientation;
+
+    for (uint8_t col = 0; col < 4; col++)
+      angle[col] = joint_angle(row, col);
+    referenceForward(angle, &position, &orientation);
+
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+      error = std::max(error, fabs(tool_position(row, axis) - position(axis)));
+      for (uint8_t col = 0; col < 3; col++)
+        error = std::max(error, fabs(tool_orientation(row, axis * 3 + col) - orientation(axis, col)));
+    }
+  }
+
+  printf("batch fk      %u configurations  %.3f ms  max error %.3g\n", FK_CONFIGURATION_NUM, batch_time * 1e3, error);
+}
+
+static void benchmarkViaPoint()
+{
+  ViaPointTrajectory trajectory(4);
+  std::vector<Trajectory> start(4);
+  std::vector<std::vector<double> > via_point(3, std::vector<double>(4));
+  std::vector<double> via_time;
+  std::vector<double> position, velocity, acceleration;
+
+  for (uint8_t joint = 0; joint < 4; joint++)
+  {
+    start[joint].position = 0.0;
+    start[joint].velocity = 0.0;
+    start[joint].acceleration = 0.0;
+    via_point[0][joint] = 0.3 + 0.1 * joint;
+    via_point[1][joint] = -0.2 * joint;
+    via_point[2][joint] = 0.5;
+  }
+  via_time.push_back(0.5);
+  via_time.push_back(1.2);
+  via_time.push_back(2.0);
+  trajectory.init(start, via_point, via_time, 0.0);
+
+  double error = 0.0;
+  for (uint8_t knot = 0; knot < via_time.size(); knot++)
+  {
+    trajectory.getState(via_time[knot], &position, &velocity, &acceleration);
+    for (uint8_t joint = 0; joint < 4; joint++)
+      error = std::max(error, fabs(position[joint] - via_point[knot][joint]));
+  }
+
+  printf("via point     3 knots  max knot error %.3g\n", error);
+}
+
+static void benchmarkLongMove()
+{
+  JointTrajectory trajectory(4);
+  std::vector<Trajectory> start(4), goal(4);
+  std::vector<double> position, velocity, acceleration;
+
+  for (uint8_t joint = 0; joint < 4; joint++)
+  {
+    start[joint].position = -1.0;
+    start[joint].velocity = 0.0;
+    start[joint].acceleration = 0.0;
+    goal[joint].position = 1.0 + 0.25 * joint;
+    goal[joint].velocity = 0.0;
+    goal[joint].acceleration = 0.0;
+  }
+  trajectory.init(start, goal, LONG_MOVE_TIME, ACTUATOR_CONTROL_TIME);
+  trajectory.getState(LONG_MOVE_TIME, &position, &velocity, &acceleration);
+
+  double error = 0.0;
+  for (uint8_t joint = 0; joint < 4; joint++)
+    error = std::max(error, fabs(position[joint] - goal[joint].position));
+
+  printf("long move     %.0f s  end error %.3g\n", LONG_MOVE_TIME, error);
+}
+
+static void benchmarkControlLoop()
+{
+  RobotisManipulator manipulator;
+  NullActuator actuator;
+  std::vector<double> start(4, 0.0), goal(4, 0.5);
+
+  build(&manipulator);
+  manipulator.addActuator(0, &actuator);
+  manipulator.initTrajectory(start);
+  manipulator.setPresentTime(0.0);
+  manipulator.setJointTrajectory(goal, TICK_NUM * ACTUATOR_CONTROL_TIME);
+
+  double begin = getTime();
+  for (uint32_t tick = 0; tick < TICK_NUM; tick++)
+    manipulator.controlLoop(tick * ACTUATOR_CONTROL_TIME, TOOL, 0);
+  double tick_time = (getTime() - begin) / TICK_NUM;
+
+  printf("control loop  %u ticks  %.3f us per tick\n", TICK_NUM, tick_time * 1e6);
+}
+
+int main()
+{
+  printf("Real is %s\n", (sizeof(Real) == sizeof(double)) ? "double" : "float");
+  benchmarkForward();
+  benchmarkViaPoint();
+  benchmarkLongMove();
+  benchmarkControlLoop();
+  return 0;
+}
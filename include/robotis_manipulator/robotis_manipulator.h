@@ -21,10 +21,13 @@
 
 #include "robotis_manipulator_common.h"
 #include "robotis_manipulator_manager.h"
+#include "robotis_manipulator_kinematics.h"
+#include "robotis_manipulator_drawing.h"
 #include "robotis_manipulator_trajectory_generator.h"
 #include "robotis_manipulator_math.h"
 
 #include <algorithm> // for sort()
+#include <atomic>
 
 #define ACTUATOR_CONTROL_TIME 0.010//0.010    //go out
 #define NUM_OF_DOF 4
@@ -32,6 +35,9 @@
 #define JOINT_TRAJECTORY  0
 #define TASK_TRAJECTORY   1
 #define DRAWING           2
+#define VIA_POINT_TRAJECTORY 3
+#define STREAMING_TRAJECTORY 4
+#define TOOL_MOVE            5   // command ring only
 
 
 using namespace Eigen;
@@ -52,12 +58,37 @@ void Actuator_Control(void const *argument);
 namespace ROBOTIS_MANIPULATOR
 {
 
+// Motion built by the planner thread in post*() and adopted by the control
+// loop. The trajectory objects and the joint table are swapped with the ones
+// the control loop runs, so the slot keeps the old ones for its next command.
+typedef struct
+{
+  Name trajectory_type;
+  Name tool_name;
+  double move_time;
+  Name object;
+  double tool_value;
+  std::vector<double> goal_position;        // streaming target
+  JointTrajectory *joint_trajectory;
+  TaskTrajectory *task_trajectory;
+  ViaPointTrajectory *via_point_trajectory;
+  Matrix3r task_start_orientation;
+  Vector3r task_rotation_axis;
+  std::vector<double> joint_table;          // task or drawing motion, DOF angles per row
+  double joint_table_step;
+} Command;
+
 class RobotisManipulator
 {
 private:
   Manipulator manipulator_;
 
   Goal previous_goal_;
+  Goal goal_;
+  std::vector<double> task_position_;
+  std::vector<double> task_velocity_;
+  std::vector<double> task_acceleration_;
+  std::vector<double> actuator_angle_;
 
   JointTrajectory *joint_trajectory_;
   std::vector<Trajectory> start_joint_trajectory_;
@@ -66,10 +97,18 @@ private:
   TaskTrajectory *task_trajectory_;
   std::vector<Trajectory> start_task_trajectory_;
   std::vector<Trajectory> goal_task_trajectory_;
+  Matrix3r task_start_orientation_;
+  Vector3r task_rotation_axis_;       // world frame, zero when the orientation does not change
+
+  ViaPointTrajectory *via_point_trajectory_;
+  StreamingTrajectory *streaming_trajectory_;
+  std::vector<double> streaming_goal_;
 
   Kinematics *kinematics_;
+  DampedLeastSquares inverse_solver_;
   std::map<Name, Actuator *> actuator_;
   std::map<Name, Drawing *> drawing_;
+  std::vector<Drawing *> built_in_drawing_;   // made by addBuiltInDraw(), deleted with the manipulator
 
   double move_time_;
   double control_time_;
@@ -84,6 +123,61 @@ private:
   Name object_;
   Name trajectory_type_;
 
+  std::vector<Motion> motion_queue_;  // ring buffer, empty when the queue is disabled
+  uint8_t motion_queue_head_;
+  uint8_t motion_queue_size_;
+  double blend_time_;
+  bool dequeuing_;
+
+  Name velocity_profile_;
+  double acceleration_ratio_;
+  double jerk_ratio_;
+
+  bool precompute_task_;
+  std::vector<double> joint_table_;   // precomputed task or drawing motion, DOF angles per row
+  double joint_table_step_;
+
+  double tick_time_;                        // trajectory time, advanced at the override speed
+  double override_time_;                    // present time of the last tick_time_ update
+  StreamingTrajectory speed_override_;      // jerk limited ramp of the speed override
+  std::vector<double> speed_;               // speed, its rate and its acceleration
+  std::vector<double> speed_rate_;
+  std::vector<double> speed_acceleration_;
+
+  std::vector<Command> command_ring_;       // one slot stays empty to tell full from empty
+  std::atomic<uint32_t> command_head_;      // written by the control loop only
+  std::atomic<uint32_t> command_tail_;      // written by the planner only
+  Manipulator planner_manipulator_;
+  DampedLeastSquares planner_solver_;
+  std::vector<double> planner_position_;    // where the last posted command ends
+
+  bool isMotionQueued();
+  Motion makeMotion(Name trajectory_type, Name tool_name, double move_time);
+  bool pushMotion(const Motion &motion);
+  void startQueuedMotion();
+  void startMotion(const Motion &motion);
+  Command *beginCommand(Name trajectory_type, Name tool_name, double move_time);
+  void postCommand();
+  void adoptCommand();
+  void startCommand(Command *command);
+  Pose getPlannerPose(Name tool_name);
+  void makeCommandTable(Command *command);
+  bool postDrawing(Name tool_name, int object, double move_time, double option, const Vector3r *meter);
+
+  double limitMoveTime(double move_time, double fastest_move_time);
+  void getProfilePeak(double *velocity, double *acceleration, double *jerk);
+
+  void solveInverse(Name tool_name, Pose goal_pose, std::vector<double> *goal_angle);
+  void solveInverse(Manipulator *manipulator, DampedLeastSquares *solver, Name tool_name, Pose goal_pose, std::vector<double> *goal_angle);
+  double getFastestMoveTime(Manipulator *manipulator, const std::vector<double> &start_position, const std::vector<double> &goal_position);
+  double getFastestMoveTime(Manipulator *manipulator, DampedLeastSquares *solver, const std::vector<double> &start_position,
+                            Name tool_name, Pose goal_pose);
+  void getTaskPose(double tick, Goal *goal);
+  void makeJointTable(Name tool_name);
+  void getJointAngleFromTable(double tick, Goal *joint_goal_states);
+  double getTickTime();
+  void scaleGoalToSpeed(Goal *goal);
+
 public:
   RobotisManipulator();
   virtual ~RobotisManipulator();
@@ -91,62 +185,67 @@ public:
   void initKinematics(Kinematics *kinematics);
   void addActuator(Name name, Actuator *actuator);
   void addDraw(Name name, Drawing *drawing);
+  // Adds a built-in drawing (LINE_DRAWING, CIRCLE_DRAWING, ...) and returns it
+  // for its typed setParam(). NULL if drawing_type is unknown.
+  DrawingPrimitive *addBuiltInDraw(Name name, Name drawing_type);
 
   void initTrajectory(std::vector<double> angle_vector);
 
   ///////////////////////////*initialize function*/////////////////////////////
   void addWorld(Name world_name,
                 Name child_name,
-                Vector3f world_position = Vector3f::Zero(),
-                Matrix3f world_orientation = Matrix3f::Identity(3, 3));
+                Vector3r world_position = Vector3r::Zero(),
+                Matrix3r world_orientation = Matrix3r::Identity(3, 3));
 
   void addComponent(Name my_name,
                     Name parent_name,
                     Name child_name,
-                    Vector3f relative_position,
-                    Matrix3f relative_orientation,
-                    Vector3f axis_of_rotation = Vector3f::Zero(),
+                    Vector3r relative_position,
+                    Matrix3r relative_orientation,
+                    Vector3r axis_of_rotation = Vector3r::Zero(),
                     int8_t actuator_id = -1,
                     double coefficient = 1,
                     double mass = 0.0,
-                    Matrix3f inertia_tensor = Matrix3f::Identity(3, 3),
-                    Vector3f center_of_mass = Vector3f::Zero());
+                    Matrix3r inertia_tensor = Matrix3r::Identity(3, 3),
+                    Vector3r center_of_mass = Vector3r::Zero());
 
   void addTool(Name my_name,
                Name parent_name,
-               Vector3f relative_position,
-               Matrix3f relative_orientation,
+               Vector3r relative_position,
+               Matrix3r relative_orientation,
                int8_t tool_id = -1,
                double coefficient = 1,
                double mass = 0.0,
-               Matrix3f inertia_tensor = Matrix3f::Identity(3, 3),
-               Vector3f center_of_mass = Vector3f::Zero());
+               Matrix3r inertia_tensor = Matrix3r::Identity(3, 3),
+               Vector3r center_of_mass = Vector3r::Zero());
 
   void addComponentChild(Name my_name, Name child_name);
   void checkManipulatorSetting();
 
   ///////////////////////////////Set function//////////////////////////////////
   void setWorldPose(Pose world_pose);
-  void setWorldPosition(Vector3f world_position);
-  void setWorldOrientation(Matrix3f world_orientation);
+  void setWorldPosition(Vector3r world_position);
+  void setWorldOrientation(Matrix3r world_orientation);
   void setWorldState(State world_state);
-  void setWorldVelocity(VectorXf world_velocity);
-  void setWorldAcceleration(VectorXf world_acceleration);
+  void setWorldVelocity(VectorXr world_velocity);
+  void setWorldAcceleration(VectorXr world_acceleration);
 
   void setComponent(Name name, Component component);
   void setComponentPoseToWorld(Name name, Pose pose_to_world);
-  void setComponentPositionToWorld(Name name, Vector3f position_to_world);
-  void setComponentOrientationToWorld(Name name, Matrix3f orientation_to_wolrd);
+  void setComponentPositionToWorld(Name name, Vector3r position_to_world);
+  void setComponentOrientationToWorld(Name name, Matrix3r orientation_to_wolrd);
   void setComponentStateToWorld(Name name, State state_to_world);
-  void setComponentVelocityToWorld(Name name, VectorXf velocity);
-  void setComponentAccelerationToWorld(Name name, VectorXf accelaration);
+  void setComponentVelocityToWorld(Name name, VectorXr velocity);
+  void setComponentAccelerationToWorld(Name name, VectorXr accelaration);
   void setComponentJointAngle(Name name, double angle);
   void setComponentJointVelocity(Name name, double angular_velocity);
   void setComponentJointAcceleration(Name name, double angular_acceleration);
+  void setComponentJointAngleLimit(Name name, double min_angle, double max_angle);
+  void setComponentJointMotionLimit(Name name, double max_velocity, double max_acceleration, double max_jerk);
   void setComponentToolOnOff(Name name, bool on_off);
   void setComponentToolValue(Name name, double actuator_value);
 
-  void setAllActiveJointAngle(std::vector<double> angle_vector);
+  void setAllActiveJointAngle(const std::vector<double> &angle_vector);
 
   ///////////////////////////////Get function//////////////////////////////////
   int8_t getDOF();
@@ -155,11 +254,11 @@ public:
   Name getWorldName();
   Name getWorldChildName();
   Pose getWorldPose();
-  Vector3f getWorldPosition();
-  Matrix3f getWorldOrientation();
+  Vector3r getWorldPosition();
+  Matrix3r getWorldOrientation();
   State getWorldState();
-  VectorXf getWorldVelocity();
-  VectorXf getWorldAcceleration();
+  VectorXr getWorldVelocity();
+  VectorXr getWorldAcceleration();
 
   std::map<Name, Component> getAllComponent();
   std::map<Name, Component>::iterator getIteratorBegin();
@@ -168,18 +267,18 @@ public:
   Name getComponentParentName(Name name);
   std::vector<Name> getComponentChildName(Name name);
   Pose getComponentPoseToWorld(Name name);
-  Vector3f getComponentPositionToWorld(Name name);
-  Matrix3f getComponentOrientationToWorld(Name name);
+  Vector3r getComponentPositionToWorld(Name name);
+  Matrix3r getComponentOrientationToWorld(Name name);
   State getComponentStateToWorld(Name name);
-  VectorXf getComponentVelocityToWorld(Name name);
-  VectorXf getComponentAccelerationToWorld(Name name);
+  VectorXr getComponentVelocityToWorld(Name name);
+  VectorXr getComponentAccelerationToWorld(Name name);
   Pose getComponentRelativePoseToParent(Name name);
-  Vector3f getComponentRelativePositionToParent(Name name);
-  Matrix3f getComponentRelativeOrientationToParent(Name name);
+  Vector3r getComponentRelativePositionToParent(Name name);
+  Matrix3r getComponentRelativeOrientationToParent(Name name);
   Joint getComponentJoint(Name name);
   int8_t getComponentJointId(Name name);
   double getComponentJointCoefficient(Name name);
-  Vector3f getComponentJointAxis(Name name);
+  Vector3r getComponentJointAxis(Name name);
   double getComponentJointAngle(Name name);
   double getComponentJointVelocity(Name name);
   double getComponentJointAcceleration(Name name);
@@ -189,29 +288,41 @@ public:
   bool getComponentToolOnOff(Name name);
   double getComponentToolValue(Name name);
   double getComponentMass(Name name);
-  Matrix3f getComponentInertiaTensor(Name name);
-  Vector3f getComponentCenterOfMass(Name name);
+  Matrix3r getComponentInertiaTensor(Name name);
+  Vector3r getComponentCenterOfMass(Name name);
 
   std::vector<double> getAllJointAngle();
   std::vector<double> getAllActiveJointAngle();
   std::vector<uint8_t> getAllActiveJointID();
 
   // KINEMATICS (INCLUDES VIRTUAL)
-  MatrixXf jacobian(Name tool_name);
+  MatrixXr jacobian(Name tool_name);
   void forward();
   void forward(Name first_component_name);
+  void forward(Name tool_name, const MatrixXr &joint_angle, MatrixXr *tool_position, MatrixXr *tool_orientation);
+  void setLazyForwardKinematics(bool lazy);
   std::vector<double> inverse(Name tool_name, Pose goal_pose);
+  uint32_t inverse(Name tool_name,
+                   const std::vector<Pose> &goal_pose,
+                   std::vector<std::vector<double> > *goal_angle,
+                   std::vector<InverseResult> *result,
+                   bool seed_from_previous,
+                   uint8_t thread_num);
+  void setInverseOption(InverseOption option);
+  InverseResult getInverseResult();
 
   // ACTUATOR (INCLUDES VIRTUAL)
   void actuatorInit(Name actuator_name, const void *arg);
   void setActuatorControlMode(Name actuator_name);
   void actuatorEnable(Name actuator_name);
   void actuatorDisable(Name actuator_name);
-  std::vector<double> sendAllActuatorAngle(Name actuator_name, std::vector<double> radian_vector);
+  std::vector<double> sendAllActuatorAngle(Name actuator_name, const std::vector<double> &radian_vector);
+  void sendAllActuatorAngle(Name actuator_name, const std::vector<double> &radian_vector, std::vector<double> *actuator_angle);
   std::vector<double> sendMultipleActuatorAngle(std::vector<uint8_t> active_joint_id, std::vector<double> radian_vector);
   double sendActuatorAngle(uint8_t active_joint_id, double radian);
   bool sendActuatorSignal(Name actuator_name, uint8_t active_joint_id, bool onoff);
   std::vector<double> receiveAllActuatorAngle(Name actuator_name);
+  void receiveAllActuatorAngle(Name actuator_name, std::vector<double> *joint_angle);
 
   // DRAW (INCLUDES VIRTUAL)
   void drawInit(Name name, double move_time, const void *arg);
@@ -232,6 +343,59 @@ public:
 
   void makeTrajectory(std::vector<Trajectory> start, std::vector<Trajectory> goal);
 
+  // Speed override: running and following trajectories advance at speed
+  // (0 to 2) times their planned speed. Changes ramp with the rate [1/s],
+  // acceleration [1/s^2] and jerk [1/s^3] limits of the speed. Above 1 the
+  // motion runs faster than the joint limits used to time it.
+  void setSpeedOverride(double speed);
+  void setSpeedOverrideLimit(double rate, double acceleration, double jerk);
+  double getSpeedOverride();
+
+  // Velocity profile of rest to rest moves: MINIMUM_JERK_PROFILE (default),
+  // TRAPEZOIDAL_PROFILE or DOUBLE_S_PROFILE. The acceleration phase lasts
+  // acceleration_ratio * move_time and its jerk phases jerk_ratio of that.
+  void setVelocityProfile(Name profile_type, double acceleration_ratio = 1.0 / 3.0, double jerk_ratio = 1.0 / 3.0);
+  Name getVelocityProfile();
+
+  // Shortest move time of a move from the previous goal, with the present velocity
+  // profile, that keeps every joint within its velocity, acceleration and jerk limits.
+  // Trajectory setters never go faster than this, so a move_time of 0 means "as fast as allowed".
+  double getFastestMoveTime(std::vector<double> goal_position);
+  double getFastestMoveTime(Name tool_name, Pose goal_pose);
+
+  // Motion queue: while moving, trajectory setters append to the queue instead
+  // of replacing the present motion. Joint space motions are blended over the
+  // last blend_time seconds of the previous one. A setter returns false when
+  // its motion is dropped because the queue is full.
+  void setMotionQueue(uint8_t capacity, double blend_time);
+  void clearMotionQueue();
+  uint8_t getMotionQueueSize();
+  bool isMotionQueueFull();
+
+  // Command ring: one planner thread posts motion commands without locking.
+  // post*() runs the inverse kinematics, solves the trajectory and fills the
+  // joint table of task and drawing motions on the calling thread, always
+  // precomputed, and plans each command from where the one before it ends.
+  // The control loop starts the next command once the present motion has
+  // finished, at the start of a tick, by swapping in the finished trajectory;
+  // a streaming target retargets a running stream at once. post*() never
+  // blocks and returns false when the ring is full or not set, or when the
+  // motion cannot be built.
+  // Set the ring after initTrajectory(), while the manipulator is at rest and
+  // before the control loop runs on another thread; from then on move it only
+  // through post*(). Pose commands are planned with the built-in kinematics
+  // even when a Kinematics is added, which the control loop keeps to itself.
+  void setCommandRing(uint8_t capacity);
+  bool postJointTrajectory(std::vector<double> goal_position, double move_time);
+  bool postJointTrajectory(Name tool_name, Pose goal_pose, double move_time);
+  bool postTaskTrajectory(Name tool_name, Pose goal_pose, double move_time);
+  bool postViaPointTrajectory(std::vector<std::vector<double> > via_point, std::vector<double> via_time, double move_time);
+  bool postDrawing(Name tool_name, int object, double move_time, double option);
+  bool postDrawing(Name tool_name, int object, double move_time, Vector3r meter);
+  bool postStreamingTarget(const std::vector<double> &goal_position);
+  bool postToolMove(Name tool_name, double tool_value);
+  bool postWait(double wait_time);
+
   void setStartTrajectory(Trajectory trajectory);
   void clearStartTrajectory();
   std::vector<Trajectory> getStartTrajectory();
@@ -244,22 +408,42 @@ public:
   // Additional Functions
 
   double toolMove(Name tool_name, double tool_value);
-  void wait(double wait_time = 1.0f);
+  bool wait(double wait_time = 1.0f);
 
   void setPreviousGoalPosition(std::vector<double> data);
   std::vector<double> getPreviousGoalPosition();
   void setStartPoseForDrawing(Name name, Pose start_pose);
   void setEndPoseForDrawing(Name name, Pose end_pose);
 
-  std::vector<double> controlLoop(double present_time, Name tool_name, Name actuator_name);
+  const std::vector<double> &controlLoop(double present_time, Name tool_name, Name actuator_name);
   Goal getJointAngleFromJointTraj();
   Goal getJointAngleFromTaskTraj(Name tool_name);
+  // A precomputed drawing fills only the joint states, not the pose
   Goal getJointAngleFromDrawing(Name tool_name);
-  void setJointTrajectory(std::vector<double> goal_position, double move_time);
-  void setJointTrajectory(Name tool_name, Pose goal_pose, double move_time);
-  void setTaskTrajectory(Name tool_name, Pose goal_pose, double move_time);
-  void setDrawing(Name tool_name, int object, double move_time, double option);
-  void setDrawing(Name tool_name, int object, double move_time, Vector3f meter);
+  void getJointAngleFromJointTraj(Goal *joint_goal_states);
+  void getJointAngleFromTaskTraj(Name tool_name, Goal *joint_goal_states);
+  void getJointAngleFromDrawing(Name tool_name, Goal *joint_goal_states);
+  void getJointAngleFromViaPointTraj(Goal *joint_goal_states);
+  void getJointAngleFromStreamingTraj(Goal *joint_goal_states);
+  bool setJointTrajectory(std::vector<double> goal_position, double move_time);
+  bool setJointTrajectory(Name tool_name, Pose goal_pose, double move_time);
+  // Solve the inverse kinematics of the whole task or drawing motion when it is set,
+  // so the control loop only interpolates joint angles instead of running it every tick
+  void setTaskPrecompute(bool precompute);
+  bool getTaskPrecompute();
+
+  // Straight line to goal_pose.position while the orientation turns about one axis to goal_pose.orientation
+  bool setTaskTrajectory(Name tool_name, Pose goal_pose, double move_time);
+  bool setViaPointTrajectory(std::vector<std::vector<double> > via_point, std::vector<double> via_time, double move_time);
+  bool setViaPointTrajectory(Name tool_name, std::vector<Pose> via_pose, std::vector<double> via_time, double move_time);
+  // Streaming: every call only moves the target; controlLoop() tracks it under
+  // the joint velocity, acceleration and jerk limits from the present state.
+  // The first call preempts: the present motion stops being followed and the
+  // motion queue is cleared.
+  void setStreamingTarget(const std::vector<double> &goal_position);
+  void setStreamingTarget(Name tool_name, Pose goal_pose);
+  bool setDrawing(Name tool_name, int object, double move_time, double option);
+  bool setDrawing(Name tool_name, int object, double move_time, Vector3r meter);
 
 };
 } // namespace OPEN_MANIPULATOR
@@ -5,28 +5,48 @@
 
 using namespace Eigen;
 
+// Scalar type of the math, kinematics and trajectory coefficients.
+// Build with ROBOTIS_MANIPULATOR_DOUBLE_PRECISION for a double-only library. The
+// CMake option exports the define to dependent catkin packages as well.
+#ifdef ROBOTIS_MANIPULATOR_DOUBLE_PRECISION
+typedef double Real;
+#else
+typedef float Real;
+#endif
+
+typedef Matrix<Real, 3, 1> Vector3r;
+typedef Matrix<Real, 3, 3> Matrix3r;
+typedef Matrix<Real, 6, 1> Vector6r;
+typedef Matrix<Real, Dynamic, 1> VectorXr;
+typedef Matrix<Real, Dynamic, Dynamic> MatrixXr;
+
 typedef int8_t Name;
 
 typedef struct
 {
-  Vector3f position;
-  Matrix3f orientation;
+  Vector3r position;
+  Matrix3r orientation;
 } Pose;
 
 typedef struct
 {
-  VectorXf velocity;
-  VectorXf acceleration;
+  VectorXr velocity;
+  VectorXr acceleration;
 } State;
 
 typedef struct
 {
   int8_t id;
-  Vector3f axis;
+  Vector3r axis;
   double coefficient; //actuator angle to joint angle
   double angle;
   double velocity;
   double acceleration;
+  double min_angle;
+  double max_angle;
+  double max_velocity;
+  double max_acceleration;
+  double max_jerk;
 } Joint;
 
 typedef struct
@@ -40,8 +60,8 @@ typedef struct
 typedef struct
 {
   double mass;
-  Matrix3f inertia_tensor;
-  Vector3f center_of_mass;
+  Matrix3r inertia_tensor;
+  Vector3r center_of_mass;
 } Inertia;
 
 typedef struct
@@ -70,9 +90,25 @@ typedef struct
   std::vector<double> velocity;
   std::vector<double> acceleration;
   Pose pose;
-  Pose pose_vel;
+  Pose pose_vel;                              // orientation holds the time derivative of pose.orientation
   Pose pose_acc;
 } Goal;
 
+typedef struct
+{
+  Name trajectory_type;                       // a JOINT_TRAJECTORY without goal_position is a wait
+  Name tool_name;
+  double move_time;
+  std::vector<double> goal_position;
+  Pose goal_pose;
+  bool use_goal_pose;                         // joint trajectory to goal_pose through inverse kinematics
+  std::vector<std::vector<double> > via_point;
+  std::vector<double> via_time;
+  int object;
+  double option;
+  Vector3r meter;
+  bool use_meter;
+} Motion;
+
 
 #endif // ROBOTIS_MANIPULATOR_COMMON_H
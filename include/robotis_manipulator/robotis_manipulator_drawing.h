@@ -0,0 +1,209 @@
+﻿/*******************************************************************************
+* Copyright 2016 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM */
+
+#ifndef RMDRAWING_H_
+#define RMDRAWING_H_
+
+#include <eigen3/Eigen/Eigen>
+
+#include <math.h>
+#include <vector>
+
+#include "robotis_manipulator_common.h"
+#include "robotis_manipulator_manager.h"
+#include "robotis_manipulator_trajectory_generator.h"
+
+#define LINE_DRAWING 0
+#define CIRCLE_DRAWING 1
+#define ARC_DRAWING 2
+#define ELLIPSE_DRAWING 3
+#define HELIX_DRAWING 4
+#define SPIRAL_DRAWING 5
+#define CURVE_DRAWING 6
+
+#define CURVE_MAX_DEGREE 5
+
+namespace ROBOTIS_MANIPULATOR
+{
+
+// Path p(s), s in [0, 1], drawn from the start pose with a minimum jerk
+// time scaling s(t). The orientation stays at the start orientation.
+class DrawingPrimitive : public Drawing
+{
+protected:
+  Pose start_pose_;
+  MinimumJerkProfile time_scaling_;
+
+  // Offset from the start position and its derivatives with respect to s
+  virtual void getPath(double s, Vector3r *position, Vector3r *first_derivative, Vector3r *second_derivative) = 0;
+  virtual void getTimeScaling(double tick, double *s, double *ds, double *dds);
+
+public:
+  DrawingPrimitive();
+  virtual ~DrawingPrimitive();
+
+  virtual void setMoveTime(double move_time);
+
+  // arg: {move_time, control_time} as passed by setDrawing()
+  virtual void initDraw(const void *arg);
+
+  // The shape comes from setParam(), so the radius, end pose and angular start
+  // position that setDrawing() passes are ignored unless a primitive overrides them.
+  virtual void setRadius(double radius);
+  virtual void setStartPose(Pose start_pose);
+  virtual void setEndPose(Pose end_pose);
+  virtual void setAngularStartPosition(double start_position);
+  virtual Pose getPose(double tick);
+  virtual void getState(double tick, Pose *pose, Pose *pose_vel, Pose *pose_acc);
+};
+
+// Straight line over displacement [m]
+class Line : public DrawingPrimitive
+{
+private:
+  Vector3r displacement_;
+
+protected:
+  virtual void getPath(double s, Vector3r *position, Vector3r *first_derivative, Vector3r *second_derivative);
+
+public:
+  Line();
+  virtual ~Line();
+
+  void setParam(Vector3r displacement);
+  virtual void setEndPose(Pose end_pose);
+};
+
+// Ellipse in the world XY plane through the start position, which lies at
+// start_angle on it. The radii can grow along the path and the path can
+// rise along z, which covers circles, arcs, helices and spirals.
+class Ellipse : public DrawingPrimitive
+{
+protected:
+  double radius_x_;
+  double radius_y_;
+  double radius_growth_;   // radius change over the whole path [m]
+  double height_;          // z change over the whole path [m]
+  double start_angle_;     // [rad]
+  double sweep_angle_;     // [rad], negative turns clockwise
+
+  virtual void getPath(double s, Vector3r *position, Vector3r *first_derivative, Vector3r *second_derivative);
+
+public:
+  Ellipse();
+  virtual ~Ellipse();
+
+  void setParam(double radius_x, double radius_y, double revolution, double start_angle);
+};
+
+class Circle : public Ellipse
+{
+public:
+  Circle();
+  virtual ~Circle();
+
+  void setParam(double radius, double revolution, double start_angle);
+};
+
+class Arc : public Ellipse
+{
+public:
+  Arc();
+  virtual ~Arc();
+
+  void setParam(double radius, double start_angle, double sweep_angle);
+};
+
+// Circular helix rising pitch [m] per revolution
+class Helix : public Ellipse
+{
+public:
+  Helix();
+  virtual ~Helix();
+
+  void setParam(double radius, double pitch, double revolution, double start_angle);
+};
+
+// Archimedean spiral from start_radius to end_radius
+class Spiral : public Ellipse
+{
+public:
+  Spiral();
+  virtual ~Spiral();
+
+  void setParam(double start_radius, double end_radius, double revolution, double start_angle);
+};
+
+// Polyline, piecewise cubic Bezier or B-spline (NURBS with weights) path
+// drawn at a constant feed rate. The curve is reparameterized by arc length
+// through a precomputed table, so a tick costs two binary searches. Points
+// are in the world frame; the path is shifted so it begins at the start pose.
+// The feed rate ramps up and down over the acceleration time (0.2 s by default).
+// Polyline corners are passed at full feed; use Bezier segments to round them.
+class CurveDrawing : public DrawingPrimitive
+{
+private:
+  uint8_t degree_;
+  std::vector<Vector3r> control_point_;
+  std::vector<double> weight_;            // empty for a non-rational curve
+  std::vector<double> knot_;
+  Vector3r origin_;                       // first point of the curve
+  uint32_t resolution_;
+  std::vector<double> table_length_;      // arc length at table_parameter_
+  std::vector<double> table_parameter_;
+  double acceleration_time_;
+  DoubleSProfile feed_profile_;
+
+  void makeArcLengthTable();
+  uint32_t findSpan(double u);
+  void getCurve(double u, Vector3r *position, Vector3r *first_derivative, Vector3r *second_derivative);
+
+protected:
+  virtual void getPath(double s, Vector3r *position, Vector3r *first_derivative, Vector3r *second_derivative);
+  virtual void getTimeScaling(double tick, double *s, double *ds, double *dds);
+
+public:
+  CurveDrawing();
+  virtual ~CurveDrawing();
+
+  void setPolyline(const std::vector<Vector3r> &point);
+  // Cubic segments: points 3k lie on the path, 3k+1 and 3k+2 are their handles
+  bool setBezier(const std::vector<Vector3r> &point);
+  // Clamped B-spline of degree <= CURVE_MAX_DEGREE. Uniform knots when knot
+  // is empty, rational (NURBS) when weight is not empty.
+  bool setBSpline(const std::vector<Vector3r> &control_point,
+                  uint8_t degree,
+                  const std::vector<double> &knot,
+                  const std::vector<double> &weight);
+  // Arc length table samples, 1000 by default. Call before setting the curve.
+  void setResolution(uint32_t resolution);
+
+  // Returns the move time that draws the curve at feed_rate [m/s], or 0 and
+  // changes nothing if feed_rate <= 0 or acceleration_time < 0
+  double setFeedRate(double feed_rate, double acceleration_time);
+  double getLength();
+  virtual void setMoveTime(double move_time);
+};
+
+// Built-in drawing of the given type (LINE_DRAWING, ...), NULL if unknown.
+// The caller owns the returned drawing.
+DrawingPrimitive *makeDrawing(Name drawing_type);
+
+} // namespace ROBOTIS_MANIPULATOR
+
+#endif // RMDRAWING_H_
@@ -0,0 +1,100 @@
+﻿/*******************************************************************************
+* Copyright 2016 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM */
+
+#ifndef RMEXECUTOR_H_
+#define RMEXECUTOR_H_
+
+#include <atomic>
+#include <pthread.h>
+#include <thread>
+
+#include "robotis_manipulator.h"
+
+typedef struct
+{
+  int priority;           // SCHED_FIFO priority (1 - 99), 0 keeps the default scheduler
+  int cpu;                // CPU the thread is pinned to, -1 for any
+  bool lock_memory;       // mlockall() so ticks never page fault. This locks the
+                          // whole process until stop() calls munlockall().
+} ExecutorOption;
+
+typedef struct
+{
+  uint64_t tick;
+  uint64_t overrun;             // ticks that ended after the next deadline
+  double max_latency;           // wake up delay after the deadline [s]
+  double max_execution_time;    // controlLoop() duration [s]
+  bool realtime;                // SCHED_FIFO was applied
+  bool pinned;                  // CPU affinity was applied
+  bool memory_locked;           // mlockall() succeeded for the last start()
+  int sleep_error;              // clock_nanosleep() error that stopped the thread, 0 if none
+} ExecutorStat;
+
+namespace ROBOTIS_MANIPULATOR
+{
+
+// Runs controlLoop() on its own thread every control time of the manipulator.
+// Ticks sleep to absolute deadlines on CLOCK_MONOTONIC, so the period does not
+// drift; an overrun skips the missed deadlines instead of bursting to catch up.
+// The present time passed to controlLoop() keeps increasing across stop() and
+// start(), so a motion started before a restart keeps its start time.
+// Planner code that calls the manipulator while the executor runs must hold
+// lock() so it never interleaves with a tick. The lock is a priority
+// inheritance mutex, so a planner holding it runs at the tick priority until
+// it unlocks; keep that section short, or post commands through the command
+// ring, which needs no lock.
+class ControlExecutor
+{
+private:
+  RobotisManipulator *manipulator_;
+  Name tool_name_;
+  Name actuator_name_;
+  ExecutorOption option_;
+  ExecutorStat stat_;
+
+  std::thread thread_;
+  std::atomic<bool> running_;
+  pthread_mutex_t mutex_;
+  bool memory_locked_;  // mlockall() is in effect until stop()
+  double present_time_; // present time of the last tick, continued by the next start()
+
+  void run();
+
+public:
+  ControlExecutor(RobotisManipulator *manipulator);
+  virtual ~ControlExecutor();
+
+  void setOption(ExecutorOption option);
+  ExecutorOption getOption();
+
+  // Fails while running or when the control time of the manipulator is not positive
+  bool start(Name tool_name, Name actuator_name);
+  void stop();
+  bool isRunning();
+
+  void lock();
+  void unlock();
+
+  ExecutorStat getStat();
+  // Clears the tick counters and the sleep error; the realtime, pinned and memory flags stay
+  void resetStat();
+};
+
+} // namespace ROBOTIS_MANIPULATOR
+
+#endif // RMEXECUTOR_H_
@@ -0,0 +1,103 @@
+﻿/*******************************************************************************
+* Copyright 2016 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM */
+
+#ifndef RMKINEMATICS_H_
+#define RMKINEMATICS_H_
+
+#include <eigen3/Eigen/Eigen>
+
+#include <thread>
+#include <vector>
+
+#include "robotis_manipulator_common.h"
+#include "robotis_manipulator_manager.h"
+#include "robotis_manipulator_math.h"
+
+typedef struct
+{
+  uint8_t max_iteration;
+  Real tolerance;     // norm of the pose error [m, rad]
+  Real damping;       // initial damping factor
+  Real min_damping;
+  Real max_damping;
+} InverseOption;
+
+typedef struct
+{
+  bool converged;
+  uint8_t iteration;
+  Real residual;      // norm of the pose error at the returned angles
+} InverseResult;
+
+namespace ROBOTIS_MANIPULATOR
+{
+class DampedLeastSquares
+{
+private:
+  InverseOption option_;
+  InverseResult result_;
+
+  MatrixXr jacobian_;
+  MatrixXr normal_matrix_;
+  Vector6r pose_error_;
+  Vector6r trial_error_;
+  VectorXr gradient_;
+  VectorXr delta_;
+  LDLT<MatrixXr> decomposition_;
+  std::vector<double> trial_angle_;
+  std::vector<double> min_angle_;
+  std::vector<double> max_angle_;
+
+public:
+  DampedLeastSquares();
+  virtual ~DampedLeastSquares();
+
+  void setOption(InverseOption option);
+  InverseOption getOption();
+  InverseResult getResult();
+
+  // Levenberg-Marquardt: a step that does not lower the pose error is rejected
+  // and retried with more damping. Each try counts as an iteration.
+  bool solve(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<double> *goal_angle);
+
+  // Solves every target on thread_num workers (0: one per core), each with its
+  // own copy of the manipulator. With seed_from_previous, a target starts from
+  // the previous converged solution of its worker instead of the manipulator's
+  // present angles. Returns the number of converged targets.
+  uint32_t solve(const Manipulator &manipulator,
+                 Name tool_name,
+                 const std::vector<Pose> &target_pose,
+                 std::vector<std::vector<double> > *goal_angle,
+                 std::vector<InverseResult> *result,
+                 bool seed_from_previous,
+                 uint8_t thread_num);
+
+private:
+  Real getPoseError(Manipulator *manipulator, Name tool_name, const Pose &target_pose, Vector6r *pose_error);
+  void solveRange(Manipulator *manipulator,
+                  Name tool_name,
+                  const std::vector<Pose> *target_pose,
+                  std::vector<std::vector<double> > *goal_angle,
+                  std::vector<InverseResult> *result,
+                  bool seed_from_previous,
+                  uint32_t begin,
+                  uint32_t end);
+};
+} // namespace ROBOTIS_MANIPULATOR
+
+#endif // RMKINEMATICS_H_
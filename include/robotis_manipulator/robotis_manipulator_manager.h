@@ -24,11 +24,14 @@
 
 #include <vector>
 #include <map>
+#include <float.h>
 
 #include "robotis_manipulator_common.h"
 #include "robotis_manipulator_manager.h"
 #include "robotis_manipulator_math.h"
 
+#define MAX_COMPONENT_NUM 255
+
 namespace ROBOTIS_MANIPULATOR
 {
 class Manipulator
@@ -62,6 +65,11 @@ private:
   component_.at(name).joint.angle
   component_.at(name).joint.velocity
   component_.at(name).joint.acceleration
+  component_.at(name).joint.min_angle
+  component_.at(name).joint.max_angle
+  component_.at(name).joint.max_velocity
+  component_.at(name).joint.max_acceleration
+  component_.at(name).joint.max_jerk
   component_.at(name).tool.id
   component_.at(name).tool.coefficient
   component_.at(name).tool.on_off
@@ -72,38 +80,87 @@ private:
   */
   /////////////////////////////////////////////////////////////////////////////
 
+  ///////////////////////////////Compiled layout///////////////////////////////
+  /*
+  Dense structure-of-arrays copy of component_, indexed in Name order.
+  It is built once by compileComponent() and, while compiled_ is true, owns
+  the joint states and the poses to world. component_ keeps the construction
+  data and the cold fields (child, origin, tool, inertia).
+  Indices are int16_t and -1 marks an absent component. A tree of more than
+  MAX_COMPONENT_NUM components is not compiled.
+  */
+  bool compiled_;
+  int16_t index_[256];
+  std::vector<Name> index_name_;
+  std::vector<int16_t> parent_index_;
+  std::vector<int8_t> joint_id_;
+  std::vector<int8_t> tool_id_;
+  std::vector<Vector3r> joint_axis_;
+  std::vector<double> joint_coefficient_;
+  std::vector<double> joint_angle_;
+  std::vector<double> joint_velocity_;
+  std::vector<double> joint_acceleration_;
+  std::vector<double> joint_min_angle_;
+  std::vector<double> joint_max_angle_;
+  std::vector<Vector3r> relative_position_;
+  std::vector<Matrix3r> relative_orientation_;
+  std::vector<Vector3r> position_to_world_;
+  std::vector<Matrix3r> orientation_to_world_;
+  std::vector<Vector3r> joint_axis_to_world_;
+  std::vector<int16_t> active_joint_index_;
+  std::vector<double> active_joint_coefficient_;
+  std::vector<uint8_t> active_joint_receive_order_;
+  int16_t active_joint_by_id_[256];
+  std::vector<int16_t> forward_order_;
+  std::vector<int16_t> forward_order_position_;
+  std::vector<int16_t> subtree_end_;
+  std::vector<bool> pose_dirty_;
+  bool has_dirty_pose_;
+  bool lazy_forward_;
+  /////////////////////////////////////////////////////////////////////////////
+
+  void compileComponent();
+  void releaseComponent();
+  void syncComponent();
+  void addForwardOrder(int16_t index);
+  void updatePoseToWorld(uint8_t begin, uint8_t end);
+  void setPoseDirty(int16_t index);
+  void setPoseClean(int16_t index);
+  void setWorldDirty();
+  void updateLazyPose();
+
 public:
-  Manipulator() : dof_(0){};
+  Manipulator() : dof_(0), compiled_(false), has_dirty_pose_(false), lazy_forward_(false){};
   virtual ~Manipulator(){};
 
   ///////////////////////////initialize function/////////////////////////////
 
   void addWorld(Name world_name,
                 Name child_name,
-                Vector3f world_position = Vector3f::Zero(),
-                Matrix3f world_orientation = Matrix3f::Identity(3, 3));
+                Vector3r world_position = Vector3r::Zero(),
+                Matrix3r world_orientation = Matrix3r::Identity(3, 3));
 
   void addComponent(Name my_name,
                     Name parent_name,
                     Name child_name,
-                    Vector3f relative_position,
-                    Matrix3f relative_orientation,
-                    Vector3f axis_of_rotation = Vector3f::Zero(),
+                    Vector3r relative_position,
+                    Matrix3r relative_orientation,
+                    Vector3r axis_of_rotation = Vector3r::Zero(),
                     int8_t joint_actuator_id = -1,
                     double coefficient = 1.0f,
                     double mass = 0.0f,
-                    Matrix3f inertia_tensor = Matrix3f::Identity(3, 3),
-                    Vector3f center_of_mass = Vector3f::Zero());
+                    Matrix3r inertia_tensor = Matrix3r::Identity(3, 3),
+                    Vector3r center_of_mass = Vector3r::Zero());
 
   void addTool(Name my_name,
                Name parent_name,
-               Vector3f relative_position,
-               Matrix3f relative_orientation,
+               Vector3r relative_position,
+               Matrix3r relative_orientation,
                int8_t tool_id = -1,
                double coefficient = 1.0f,
                double mass = 0.0f,
-               Matrix3f inertia_tensor = Matrix3f::Identity(3, 3),
-               Vector3f center_of_mass = Vector3f::Zero());
+               Matrix3r inertia_tensor = Matrix3r::Identity(3, 3),
+               Vector3r center_of_mass = Vector3r::Zero());
 
   void addComponentChild(Name my_name, Name child_name);
   void checkManipulatorSetting();
@@ -111,26 +168,32 @@ public:
   ///////////////////////////////Set function//////////////////////////////////
 
   void setWorldPose(Pose world_pose);
-  void setWorldPosition(Vector3f world_position);
-  void setWorldOrientation(Matrix3f world_orientation);
+  void setWorldPosition(Vector3r world_position);
+  void setWorldOrientation(Matrix3r world_orientation);
   void setWorldState(State world_state);
-  void setWorldVelocity(VectorXf world_velocity);
-  void setWorldAcceleration(VectorXf world_acceleration);
+  void setWorldVelocity(VectorXr world_velocity);
+  void setWorldAcceleration(VectorXr world_acceleration);
 
   void setComponent(Name name, Component component, bool *error = NULL);
+  // Poses to world belong to whoever wrote them last. A write here (e.g. from a
+  // user Kinematics::forward(), root to tip) marks the component's subtree clean,
+  // so the lazy or incremental update does not overwrite it until a joint angle
+  // or the world pose changes again.
   void setComponentPoseToWorld(Name name, Pose pose_to_world);
-  void setComponentPositionToWorld(Name name, Vector3f position_to_world);
-  void setComponentOrientationToWorld(Name name, Matrix3f orientation_to_wolrd);
+  void setComponentPositionToWorld(Name name, Vector3r position_to_world);
+  void setComponentOrientationToWorld(Name name, Matrix3r orientation_to_wolrd);
   void setComponentStateToWorld(Name name, State state_to_world);
-  void setComponentVelocityToWorld(Name name, VectorXf velocity);
-  void setComponentAccelerationToWorld(Name name, VectorXf accelaration);
+  void setComponentVelocityToWorld(Name name, VectorXr velocity);
+  void setComponentAccelerationToWorld(Name name, VectorXr accelaration);
   void setComponentJointAngle(Name name, double angle);
   void setComponentJointVelocity(Name name, double angular_velocity);
   void setComponentJointAcceleration(Name name, double angular_acceleration);
+  void setComponentJointAngleLimit(Name name, double min_angle, double max_angle);
+  void setComponentJointMotionLimit(Name name, double max_velocity, double max_acceleration, double max_jerk);
   void setComponentToolOnOff(Name name, bool on_off);
   void setComponentToolValue(Name name, double value);
 
-  void setAllActiveJointAngle(std::vector<double> angle_vector);
+  void setAllActiveJointAngle(const std::vector<double> &angle_vector);
 
   ///////////////////////////////Get function//////////////////////////////////
 
@@ -139,11 +202,11 @@ public:
   Name getWorldName();
   Name getWorldChildName();
   Pose getWorldPose();
-  Vector3f getWorldPosition();
-  Matrix3f getWorldOrientation();
+  Vector3r getWorldPosition();
+  Matrix3r getWorldOrientation();
   State getWorldState();
-  VectorXf getWorldVelocity();
-  VectorXf getWorldAcceleration();
+  VectorXr getWorldVelocity();
+  VectorXr getWorldAcceleration();
 
   int8_t getComponentSize();
   std::map<Name, Component> getAllComponent();
@@ -153,18 +216,18 @@ public:
   Name getComponentParentName(Name name);
   std::vector<Name> getComponentChildName(Name name);
   Pose getComponentPoseToWorld(Name name);
-  Vector3f getComponentPositionToWorld(Name name);
-  Matrix3f getComponentOrientationToWorld(Name name);
+  Vector3r getComponentPositionToWorld(Name name);
+  Matrix3r getComponentOrientationToWorld(Name name);
   State getComponentStateToWorld(Name name);
-  VectorXf getComponentVelocityToWorld(Name name);
-  VectorXf getComponentAccelerationToWorld(Name name);
+  VectorXr getComponentVelocityToWorld(Name name);
+  VectorXr getComponentAccelerationToWorld(Name name);
   Pose getComponentRelativePoseToParent(Name name);
-  Vector3f getComponentRelativePositionToParent(Name name);
-  Matrix3f getComponentRelativeOrientationToParent(Name name);
+  Vector3r getComponentRelativePositionToParent(Name name);
+  Matrix3r getComponentRelativeOrientationToParent(Name name);
   Joint getComponentJoint(Name name);
   int8_t getComponentJointId(Name name);
   double getComponentJointCoefficient(Name name);
-  Vector3f getComponentJointAxis(Name name);
+  Vector3r getComponentJointAxis(Name name);
   double getComponentJointAngle(Name name);
   double getComponentJointVelocity(Name name);
   double getComponentJointAcceleration(Name name);
@@ -174,13 +237,39 @@ public:
   bool getComponentToolOnOff(Name name);
   double getComponentToolValue(Name name);
   double getComponentMass(Name name);
-  Matrix3f getComponentInertiaTensor(Name name);
-  Vector3f getComponentCenterOfMass(Name name);
+  Matrix3r getComponentInertiaTensor(Name name);
+  Vector3r getComponentCenterOfMass(Name name);
 
   std::vector<double> getAllJointAngle();
   std::vector<double> getAllActiveJointAngle();
+  void getAllActiveJointAngle(std::vector<double> *angle_vector);
+  void getAllActiveJointAngleLimit(std::vector<double> *min_angle, std::vector<double> *max_angle);
+  void getAllActiveJointMotionLimit(std::vector<double> *max_velocity, std::vector<double> *max_acceleration, std::vector<double> *max_jerk);
+
   std::vector<uint8_t> getAllActiveJointID();
 
+  ///////////////////////////////Index function////////////////////////////////
+
+  int16_t getComponentIndex(Name name);
+  Name getComponentNameByIndex(int16_t index);
+  int16_t getComponentParentIndex(int16_t index);
+  const std::vector<int16_t> &getForwardOrder();
+  const std::vector<double> &getAllActiveJointCoefficient();
+  const std::vector<uint8_t> &getAllActiveJointReceiveOrder();
+  int16_t getActiveJointIndexById(uint8_t joint_id);
+  int16_t getSubtreeEnd(int16_t index);
+
+  ///////////////////////////////Kinematics function///////////////////////////
+
+  void forwardKinematics();
+  void forwardKinematics(Name component_name);
+  // Batch FK for N configurations: joint_angle is N x DOF (one column per active joint),
+  // tool_position is N x 3 and tool_orientation N x 9 (row-major rotation per row).
+  // Reads the compiled model only; the present joint state and poses are untouched.
+  void forwardKinematics(Name tool_name, const MatrixXr &joint_angle, MatrixXr *tool_position, MatrixXr *tool_orientation);
+  void jacobian(Name tool_name, MatrixXr *jacobian_matrix);
+  void setLazyForwardKinematics(bool lazy);
+  bool getLazyForwardKinematics();
 };
 
 class Kinematics : public Manipulator
@@ -189,9 +278,9 @@ public:
   Kinematics(){};
   virtual ~Kinematics(){};
 
-  virtual MatrixXf jacobian(Manipulator *manipulator, Name tool_name) = 0;
-  virtual void forward(Manipulator *manipulator) = 0;
-  virtual void forward(Manipulator *manipulator, Name component_name) = 0;
+  virtual MatrixXr jacobian(Manipulator *manipulator, Name tool_name);
+  virtual void forward(Manipulator *manipulator);
+  virtual void forward(Manipulator *manipulator, Name component_name);
   virtual std::vector<double> inverse(Manipulator *manipulator, Name tool_name, Pose target_pose) = 0;
 };
 
@@ -212,6 +301,9 @@ public:
   virtual bool sendActuatorAngle(uint8_t actuator_id, double radian) = 0;
   virtual bool sendActuatorSignal(uint8_t actuator_id, bool onoff) = 0;
   virtual std::vector<double> receiveAllActuatorAngle(void) = 0;
+
+  // Called by the control loop. Override to send without the by-value copy.
+  virtual bool writeAllActuatorAngle(const std::vector<double> &radian_vector);
 };
 
 class Drawing
@@ -226,6 +318,10 @@ public:
   virtual void setEndPose(Pose end_pose) = 0;
   virtual void setAngularStartPosition(double start_position) = 0;
   virtual Pose getPose(double tick) = 0;
+
+  // Pose and its first and second time derivatives. Drawings that only
+  // implement getPose() report zero derivatives.
+  virtual void getState(double tick, Pose *pose, Pose *pose_vel, Pose *pose_acc);
 };
 
 } // namespace OPEN_MANIPULATOR
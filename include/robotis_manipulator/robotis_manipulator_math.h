@@ -25,35 +25,40 @@
 #include <eigen3/Eigen/LU>
 #include <math.h>
 
+#include "robotis_manipulator_common.h"
+
 using namespace Eigen;
 
 #define DEG2RAD 0.01745329252f //(M_PI / 180.0)
 #define RAD2DEG 57.2957795131f //(180.0 / M_PI)
 
-#define ZERO_VECTOR Vector3f::Zero()
-#define IDENTITY_MATRIX Matrix3f::Identity(3, 3)
+#define ZERO_VECTOR Vector3r::Zero()
+#define IDENTITY_MATRIX Matrix3r::Identity(3, 3)
 
 namespace RM_MATH
 {
-float sign(float number);
+Real sign(Real number);
 
-Vector3f makeVector3(float v1, float v2, float v3);
-Matrix3f makeMatrix3(float m11, float m12, float m13,
-                     float m21, float m22, float m23,
-                     float m31, float m32, float m33);
+Vector3r makeVector3(Real v1, Real v2, Real v3);
+Matrix3r makeMatrix3(Real m11, Real m12, Real m13,
+                     Real m21, Real m22, Real m23,
+                     Real m31, Real m32, Real m33);
 
-Vector3f matrixLogarithm(Matrix3f rotation_matrix);
-Matrix3f skewSymmetricMatrix(Vector3f v);
-Matrix3f rodriguesRotationMatrix(Vector3f axis, float angle);
+Vector3r matrixLogarithm(Matrix3r rotation_matrix);
+Matrix3r skewSymmetricMatrix(Vector3r v);
+Matrix3r rodriguesRotationMatrix(Vector3r axis, Real angle);
 
-Matrix3f makeRotationMatrix(float roll, float pitch, float yaw);
-Matrix3f makeRotationMatrix(Vector3f rotation_vector);
-Vector3f makeRotationVector(Matrix3f rotation_matrix);
+Matrix3r makeRotationMatrix(Real roll, Real pitch, Real yaw);
+Matrix3r makeRotationMatrix(Vector3r rotation_vector);
+Vector3r makeRotationVector(Matrix3r rotation_matrix);
 
-Vector3f positionDifference(Vector3f desired_position, Vector3f present_position);
-Vector3f orientationDifference(Matrix3f desired_orientation, Matrix3f present_orientation);
-VectorXf poseDifference(Vector3f desired_position, Vector3f present_position,
-                        Matrix3f desired_orientation, Matrix3f present_orientation);
+Vector3r positionDifference(Vector3r desired_position, Vector3r present_position);
+Vector3r orientationDifference(Matrix3r desired_orientation, Matrix3r present_orientation);
+VectorXr poseDifference(Vector3r desired_position, Vector3r present_position,
+                        Matrix3r desired_orientation, Matrix3r present_orientation);
+void poseDifference(const Vector3r &desired_position, const Vector3r &present_position,
+                    const Matrix3r &desired_orientation, const Matrix3r &present_orientation,
+                    Vector6r *pose_difference);
 
 template <typename T>
 T map(T x, T in_min, T in_max, T out_min, T out_max)
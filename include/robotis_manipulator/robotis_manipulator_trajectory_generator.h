@@ -30,6 +30,10 @@
 #include "robotis_manipulator/robotis_manipulator_manager.h"
 
 #define PI 3.141592
+
+#define MINIMUM_JERK_PROFILE 0
+#define TRAPEZOIDAL_PROFILE  1
+#define DOUBLE_S_PROFILE     2
 using namespace Eigen;
 
 typedef struct
@@ -44,7 +48,7 @@ namespace ROBOTIS_MANIPULATOR
 class MinimumJerk
 {
 private:
-  VectorXf coefficient_;
+  VectorXr coefficient_;
 
 public:
   MinimumJerk();
@@ -55,64 +59,210 @@ public:
                        double move_time,
                        double control_time);
 
-  VectorXf getCoefficient();
+  // Coefficients of every axis at once, one column per axis
+  void calcCoefficient(const std::vector<Trajectory> &start,
+                       const std::vector<Trajectory> &goal,
+                       double move_time,
+                       double control_time,
+                       MatrixXr *coefficient);
+
+  VectorXr getCoefficient();
 };
 
-class JointTrajectory
+// Normalized time scaling s(t) from rest at s = 0 to rest at s = 1
+class VelocityProfile
+{
+public:
+  VelocityProfile(){};
+  virtual ~VelocityProfile(){};
+
+  virtual void getState(double tick, double *s, double *ds, double *dds) = 0;
+  virtual double getMoveTime() = 0;
+};
+
+class MinimumJerkProfile : public VelocityProfile
+{
+private:
+  double move_time_;
+
+public:
+  MinimumJerkProfile();
+  virtual ~MinimumJerkProfile();
+
+  void init(double move_time);
+
+  virtual void getState(double tick, double *s, double *ds, double *dds);
+  virtual double getMoveTime();
+};
+
+// Jerk limited (double S) profile with acceleration phases of acceleration_time,
+// each starting and ending with a jerk phase of jerk_time.
+class DoubleSProfile : public VelocityProfile
+{
+protected:
+  double move_time_;
+  double acceleration_time_;
+  double jerk_time_;
+  double velocity_;
+  double acceleration_;
+  double jerk_;
+
+  void getAccelerationState(double tick, double *s, double *ds, double *dds);
+
+public:
+  DoubleSProfile();
+  virtual ~DoubleSProfile();
+
+  void init(double move_time, double acceleration_time, double jerk_time);
+  // Shortest profile over the unit distance within the given limits
+  void initFastest(double max_velocity, double max_acceleration, double max_jerk);
+
+  virtual void getState(double tick, double *s, double *ds, double *dds);
+  virtual double getMoveTime();
+  double getAccelerationTime();
+  double getJerkTime();
+};
+
+// Trapezoidal velocity: a double S profile without jerk phases
+class TrapezoidalProfile : public DoubleSProfile
+{
+public:
+  TrapezoidalProfile();
+  virtual ~TrapezoidalProfile();
+
+  void init(double move_time, double acceleration_time);
+  void initFastest(double max_velocity, double max_acceleration);
+};
+
+// Minimum jerk quintic, or a trapezoidal / double S time scaling, of a set of
+// independent axes. Shared by the joint and task trajectories.
+class AxisTrajectory
 {
 private:
   MinimumJerk trajectory_generator_;
 
-  uint8_t joint_num_;
-  MatrixXf coefficient_;
+  uint8_t axis_num_;
+  MatrixXr coefficient_;
+  MatrixXr power_coefficient_;   // coefficient_ transposed: one column per power of tick
   std::vector<double> position_;
   std::vector<double> velocity_;
   std::vector<double> acceleration_;
 
+  Name profile_type_;
+  double acceleration_ratio_;       // acceleration time / move time
+  double jerk_ratio_;               // jerk time / acceleration time
+  TrapezoidalProfile trapezoidal_profile_;
+  DoubleSProfile double_s_profile_;
+  VelocityProfile *profile_;        // NULL: the minimum jerk quintic is used
+  std::vector<double> start_position_;
+  std::vector<double> distance_;
+
 public:
-  JointTrajectory(uint8_t joint_num);
-  virtual ~JointTrajectory();
+  AxisTrajectory(uint8_t axis_num);
+  virtual ~AxisTrajectory();
 
   void init(std::vector<Trajectory> start,
             std::vector<Trajectory> goal,
             double move_time,
             double control_time);
 
+  // Profile of the following init() calls. Trapezoidal and double S profiles
+  // only apply to moves that start at rest; other moves keep the quintic.
+  void setProfile(Name profile_type, double acceleration_ratio, double jerk_ratio);
+  Name getProfile();
+
   std::vector<double> getPosition(double tick);
   std::vector<double> getVelocity(double tick);
   std::vector<double> getAcceleration(double tick);
 
-  MatrixXf getCoefficient();
+  void getPosition(double tick, std::vector<double> *position);
+  void getVelocity(double tick, std::vector<double> *velocity);
+  void getAcceleration(double tick, std::vector<double> *acceleration);
+
+  // Position, velocity and acceleration in one Horner pass over all axes
+  void getState(double tick,
+                std::vector<double> *position,
+                std::vector<double> *velocity,
+                std::vector<double> *acceleration);
+
+  MatrixXr getCoefficient();
+};
+
+class JointTrajectory : public AxisTrajectory
+{
+public:
+  JointTrajectory(uint8_t joint_num);
+  virtual ~JointTrajectory();
+};
+
+class TaskTrajectory : public AxisTrajectory
+{
+public:
+  TaskTrajectory();
+  virtual ~TaskTrajectory();
 };
 
-class TaskTrajectory
+class ViaPointTrajectory
 {
 private:
-  MinimumJerk trajectory_generator_;
+  uint8_t joint_num_;
+  std::vector<double> time_;      // knot times from the start, time_[0] = 0
+  MatrixXr coefficient_;          // rows 6i..6i+5: polynomial of segment i in (tick - time_[i]), one column per joint
+
+public:
+  ViaPointTrajectory(uint8_t joint_num);
+  virtual ~ViaPointTrajectory();
+
+  // C2 spline from the start state (position, velocity and acceleration) through
+  // every via point, ending at rest with zero acceleration. Inner segments are
+  // cubic; the first and last are quintic so the end accelerations are met.
+  // via_time holds the arrival time of each via point; if it is empty the
+  // move_time is split in proportion to the joint distance of each segment.
+  bool init(std::vector<Trajectory> start,
+            const std::vector<std::vector<double> > &via_point,
+            const std::vector<double> &via_time,
+            double move_time);
 
-  uint8_t num_of_axis_;
-  MatrixXf coefficient_;
+  void getState(double tick,
+                std::vector<double> *position,
+                std::vector<double> *velocity,
+                std::vector<double> *acceleration);
+
+  double getMoveTime();
+  std::vector<double> getTime();
+};
+
+class StreamingTrajectory
+{
+private:
+  uint8_t joint_num_;
+  std::vector<double> target_;
   std::vector<double> position_;
   std::vector<double> velocity_;
   std::vector<double> acceleration_;
+  std::vector<double> max_velocity_;
+  std::vector<double> max_acceleration_;
+  std::vector<double> max_jerk_;
 
 public:
-  TaskTrajectory();
-  virtual ~TaskTrajectory();
+  StreamingTrajectory(uint8_t joint_num);
+  virtual ~StreamingTrajectory();
 
-  void init(std::vector<Trajectory> start,
-            std::vector<Trajectory> goal,
-            double move_time,
-            double control_time);
-
-  std::vector<double> getPosition(double tick);
-  std::vector<double> getVelocity(double tick);
-  std::vector<double> getAcceleration(double tick);
+  void init(std::vector<Trajectory> start);
+  void setLimit(const std::vector<double> &max_velocity,
+                const std::vector<double> &max_acceleration,
+                const std::vector<double> &max_jerk);
+  void setTarget(const std::vector<double> &target);
 
-  MatrixXf getCoefficient();
+  // Advances every joint by one control period towards the target with bounded
+  // velocity, acceleration and jerk. Constant time per joint; returns true once
+  // every joint rests on its target.
+  bool update(double control_time,
+              std::vector<double> *position,
+              std::vector<double> *velocity,
+              std::vector<double> *acceleration);
 };
 
-
 } // namespace RM_TRAJECTORY
 #endif // RMTRAJECTORY_H_
 
@@ -26,12 +26,39 @@ using namespace Eigen;
 ////////////////////////////////Basic Function//////////////////////////////
 ////////////////////////////////////////////////////////////////////////////
 
-RobotisManipulator::RobotisManipulator() : move_time_(1.0f),
+RobotisManipulator::RobotisManipulator() : joint_trajectory_(NULL),
+                                     task_trajectory_(NULL),
+                                     kinematics_(NULL),
+                                     move_time_(1.0f),
                                      control_time_(ACTUATOR_CONTROL_TIME),
                                      moving_(false),
                                      platform_(true),
-                                     processing_(false)
-{
+                                     processing_(false),
+                                     trajectory_type_(JOINT_TRAJECTORY),
+                                     motion_queue_head_(0),
+                                     motion_queue_size_(0),
+                                     blend_time_(0.0),
+                                     dequeuing_(false),
+                                     velocity_profile_(MINIMUM_JERK_PROFILE),
+                                     acceleration_ratio_(1.0 / 3.0),
+                                     jerk_ratio_(1.0 / 3.0),
+                                     precompute_task_(false),
+                                     joint_table_step_(0.0),
+                                     tick_time_(0.0),
+                                     override_time_(0.0),
+                                     speed_override_(1),
+                                     speed_(1, 1.0),
+                                     speed_rate_(1, 0.0),
+                                     speed_acceleration_(1, 0.0),
+                                     command_head_(0),
+                                     command_tail_(0)
+{
+  std::vector<Trajectory> speed(1);
+  speed[0].position = 1.0;
+  speed[0].velocity = 0.0;
+  speed[0].acceleration = 0.0;
+  speed_override_.init(speed);
+  setSpeedOverrideLimit(4.0, 20.0, 200.0);
 //  manager_ = new Manager();
 
 
@@ -39,6 +66,9 @@ RobotisManipulator::RobotisManipulator() : move_time_(1.0f),
 
 RobotisManipulator::~RobotisManipulator()
 {
+  for (uint8_t index = 0; index < built_in_drawing_.size(); index++)
+    delete built_in_drawing_[index];
+  setCommandRing(0);
 }
 
 void RobotisManipulator::initKinematics(Kinematics *kinematics)
@@ -57,10 +87,26 @@ void RobotisManipulator::addDraw(Name name, Drawing *drawing)
   drawing_.insert(std::make_pair(name, drawing));
 }
 
+DrawingPrimitive *RobotisManipulator::addBuiltInDraw(Name name, Name drawing_type)
+{
+  DrawingPrimitive *drawing = makeDrawing(drawing_type);
+  if (drawing == NULL)
+    return NULL;
+
+  built_in_drawing_.push_back(drawing);
+  addDraw(name, drawing);
+  return drawing;
+}
+
 void RobotisManipulator::initTrajectory(std::vector<double> angle_vector)
 {
   joint_trajectory_ = new JointTrajectory(manipulator_.getDOF());
   task_trajectory_ = new TaskTrajectory();
+  via_point_trajectory_ = new ViaPointTrajectory(manipulator_.getDOF());
+  streaming_trajectory_ = new StreamingTrajectory(manipulator_.getDOF());
+  streaming_goal_.reserve(manipulator_.getDOF());
+  joint_trajectory_->setProfile(velocity_profile_, acceleration_ratio_, jerk_ratio_);
+  task_trajectory_->setProfile(velocity_profile_, acceleration_ratio_, jerk_ratio_);
 
   previous_goal_.position = angle_vector;
   previous_goal_.velocity.resize(manipulator_.getDOF());
@@ -69,6 +115,13 @@ void RobotisManipulator::initTrajectory(std::vector<double> angle_vector)
   previous_goal_.pose_vel.position.resize(3);
   previous_goal_.pose_acc.position.resize(3);
 
+  // Everything controlLoop() touches is sized here so a tick never allocates
+  goal_ = previous_goal_;
+  task_position_.resize(4);
+  task_velocity_.resize(4);
+  task_acceleration_.resize(4);
+  actuator_angle_.reserve(manipulator_.getDOF());
+
   start_joint_trajectory_.reserve(manipulator_.getDOF());
   goal_joint_trajectory_.reserve(manipulator_.getDOF());
 
@@ -79,8 +132,8 @@ void RobotisManipulator::initTrajectory(std::vector<double> angle_vector)
 
 void RobotisManipulator::addWorld(Name world_name,
                                Name child_name,
-                               Vector3f world_position,
-                               Matrix3f world_orientation)
+                               Vector3r world_position,
+                               Matrix3r world_orientation)
 {
   manipulator_.addWorld(world_name, child_name, world_position, world_orientation);
 }
@@ -88,27 +141,27 @@ void RobotisManipulator::addWorld(Name world_name,
 void RobotisManipulator::addComponent(Name my_name,
                                    Name parent_name,
                                    Name child_name,
-                                   Vector3f relative_position,
-                                   Matrix3f relative_orientation,
-                                   Vector3f axis_of_rotation,
+                                   Vector3r relative_position,
+                                   Matrix3r relative_orientation,
+                                   Vector3r axis_of_rotation,
                                    int8_t actuator_id,
                                    double coefficient,
                                    double mass,
-                                   Matrix3f inertia_tensor,
-                                   Vector3f center_of_mass)
+                                   Matrix3r inertia_tensor,
+                                   Vector3r center_of_mass)
 {
   manipulator_.addComponent(my_name, parent_name, child_name, relative_position, relative_orientation, axis_of_rotation, actuator_id, coefficient, mass, inertia_tensor, center_of_mass);
 }
 
 void RobotisManipulator::addTool(Name my_name,
                               Name parent_name,
-                              Vector3f relative_position,
-                              Matrix3f relative_orientation,
+                              Vector3r relative_position,
+                              Matrix3r relative_orientation,
                               int8_t tool_id,
                               double coefficient,
                               double mass,
-                              Matrix3f inertia_tensor,
-                              Vector3f center_of_mass)
+                              Matrix3r inertia_tensor,
+                              Vector3r center_of_mass)
 {
   manipulator_.addTool(my_name, parent_name, relative_position, relative_orientation, tool_id, coefficient, mass, inertia_tensor, center_of_mass);
 }
@@ -128,12 +181,12 @@ void RobotisManipulator::setWorldPose(Pose world_pose)
   manipulator_.setWorldPose(world_pose);
 }
 
-void RobotisManipulator::setWorldPosition(Vector3f world_position)
+void RobotisManipulator::setWorldPosition(Vector3r world_position)
 {
   manipulator_.setWorldPosition(world_position);
 }
 
-void RobotisManipulator::setWorldOrientation(Matrix3f world_orientation)
+void RobotisManipulator::setWorldOrientation(Matrix3r world_orientation)
 {
   manipulator_.setWorldOrientation(world_orientation);
 }
@@ -143,12 +196,12 @@ void RobotisManipulator::setWorldState(State world_state)
   manipulator_.setWorldState(world_state);
 }
 
-void RobotisManipulator::setWorldVelocity(VectorXf world_velocity)
+void RobotisManipulator::setWorldVelocity(VectorXr world_velocity)
 {
   manipulator_.setWorldVelocity(world_velocity);
 }
 
-void RobotisManipulator::setWorldAcceleration(VectorXf world_acceleration)
+void RobotisManipulator::setWorldAcceleration(VectorXr world_acceleration)
 {
   manipulator_.setWorldAcceleration(world_acceleration);
 }
@@ -163,12 +216,12 @@ void RobotisManipulator::setComponentPoseToWorld(Name name, Pose pose_to_world)
   manipulator_.setComponentPoseToWorld(name, pose_to_world);
 }
 
-void RobotisManipulator::setComponentPositionToWorld(Name name, Vector3f position_to_world)
+void RobotisManipulator::setComponentPositionToWorld(Name name, Vector3r position_to_world)
 {
   manipulator_.setComponentPositionToWorld(name, position_to_world);
 }
 
-void RobotisManipulator::setComponentOrientationToWorld(Name name, Matrix3f orientation_to_wolrd)
+void RobotisManipulator::setComponentOrientationToWorld(Name name, Matrix3r orientation_to_wolrd)
 {
   manipulator_.setComponentOrientationToWorld(name, orientation_to_wolrd);
 }
@@ -178,12 +231,12 @@ void RobotisManipulator::setComponentStateToWorld(Name name, State state_to_worl
   manipulator_.setComponentStateToWorld(name, state_to_world);
 }
 
-void RobotisManipulator::setComponentVelocityToWorld(Name name, VectorXf velocity)
+void RobotisManipulator::setComponentVelocityToWorld(Name name, VectorXr velocity)
 {
   manipulator_.setComponentVelocityToWorld(name, velocity);
 }
 
-void RobotisManipulator::setComponentAccelerationToWorld(Name name, VectorXf accelaration)
+void RobotisManipulator::setComponentAccelerationToWorld(Name name, VectorXr accelaration)
 {
   manipulator_.setComponentAccelerationToWorld(name, accelaration);
 }
@@ -203,6 +256,16 @@ void RobotisManipulator::setComponentJointAcceleration(Name name, double angular
   manipulator_.setComponentJointAcceleration(name, angular_acceleration);
 }
 
+void RobotisManipulator::setComponentJointAngleLimit(Name name, double min_angle, double max_angle)
+{
+  manipulator_.setComponentJointAngleLimit(name, min_angle, max_angle);
+}
+
+void RobotisManipulator::setComponentJointMotionLimit(Name name, double max_velocity, double max_acceleration, double max_jerk)
+{
+  manipulator_.setComponentJointMotionLimit(name, max_velocity, max_acceleration, max_jerk);
+}
+
 void RobotisManipulator::setComponentToolOnOff(Name name, bool on_off)
 {
   manipulator_.setComponentToolOnOff(name, on_off);
@@ -213,7 +276,7 @@ void RobotisManipulator::setComponentToolValue(Name name, double actuator_value)
   manipulator_.setComponentToolValue(name, actuator_value);
 }
 
-void RobotisManipulator::setAllActiveJointAngle(std::vector<double> angle_vector)
+void RobotisManipulator::setAllActiveJointAngle(const std::vector<double> &angle_vector)
 {
   manipulator_.setAllActiveJointAngle(angle_vector);
 }
@@ -243,12 +306,12 @@ Pose RobotisManipulator::getWorldPose()
   return manipulator_.getWorldPose();
 }
 
-Vector3f RobotisManipulator::getWorldPosition()
+Vector3r RobotisManipulator::getWorldPosition()
 {
   return manipulator_.getWorldPosition();
 }
 
-Matrix3f RobotisManipulator::getWorldOrientation()
+Matrix3r RobotisManipulator::getWorldOrientation()
 {
   return manipulator_.getWorldOrientation();
 }
@@ -258,12 +321,12 @@ State RobotisManipulator::getWorldState()
   return manipulator_.getWorldState();
 }
 
-VectorXf RobotisManipulator::getWorldVelocity()
+VectorXr RobotisManipulator::getWorldVelocity()
 {
   return manipulator_.getWorldVelocity();
 }
 
-VectorXf RobotisManipulator::getWorldAcceleration()
+VectorXr RobotisManipulator::getWorldAcceleration()
 {
   return manipulator_.getWorldAcceleration();
 }
@@ -303,12 +366,12 @@ Pose RobotisManipulator::getComponentPoseToWorld(Name name)
   return manipulator_.getComponentPoseToWorld(name);
 }
 
-Vector3f RobotisManipulator::getComponentPositionToWorld(Name name)
+Vector3r RobotisManipulator::getComponentPositionToWorld(Name name)
 {
   return manipulator_.getComponentPositionToWorld(name);
 }
 
-Matrix3f RobotisManipulator::getComponentOrientationToWorld(Name name)
+Matrix3r RobotisManipulator::getComponentOrientationToWorld(Name name)
 {
   return manipulator_.getComponentOrientationToWorld(name);
 }
@@ -318,12 +381,12 @@ State RobotisManipulator::getComponentStateToWorld(Name name)
   return manipulator_.getComponentStateToWorld(name);
 }
 
-VectorXf RobotisManipulator::getComponentVelocityToWorld(Name name)
+VectorXr RobotisManipulator::getComponentVelocityToWorld(Name name)
 {
   return manipulator_.getComponentVelocityToWorld(name);
 }
 
-VectorXf RobotisManipulator::getComponentAccelerationToWorld(Name name)
+VectorXr RobotisManipulator::getComponentAccelerationToWorld(Name name)
 {
   return manipulator_.getComponentAccelerationToWorld(name);
 }
@@ -333,12 +396,12 @@ Pose RobotisManipulator::getComponentRelativePoseToParent(Name name)
   return manipulator_.getComponentRelativePoseToParent(name);
 }
 
-Vector3f RobotisManipulator::getComponentRelativePositionToParent(Name name)
+Vector3r RobotisManipulator::getComponentRelativePositionToParent(Name name)
 {
   return manipulator_.getComponentRelativePositionToParent(name);
 }
 
-Matrix3f RobotisManipulator::getComponentRelativeOrientationToParent(Name name)
+Matrix3r RobotisManipulator::getComponentRelativeOrientationToParent(Name name)
 {
   return manipulator_.getComponentRelativeOrientationToParent(name);
 }
@@ -358,7 +421,7 @@ double RobotisManipulator::getComponentJointCoefficient(Name name)
   return manipulator_.getComponentJointCoefficient(name);
 }
 
-Vector3f RobotisManipulator::getComponentJointAxis(Name name)
+Vector3r RobotisManipulator::getComponentJointAxis(Name name)
 {
   return manipulator_.getComponentJointAxis(name);
 }
@@ -408,12 +471,12 @@ double RobotisManipulator::getComponentMass(Name name)
   return manipulator_.getComponentMass(name);
 }
 
-Matrix3f RobotisManipulator::getComponentInertiaTensor(Name name)
+Matrix3r RobotisManipulator::getComponentInertiaTensor(Name name)
 {
   return manipulator_.getComponentInertiaTensor(name);
 }
 
-Vector3f RobotisManipulator::getComponentCenterOfMass(Name name)
+Vector3r RobotisManipulator::getComponentCenterOfMass(Name name)
 {
   return manipulator_.getComponentCenterOfMass(name);
 }
@@ -435,78 +498,167 @@ std::vector<uint8_t> RobotisManipulator::getAllActiveJointID()
 
 // KINEMATICS
 
-MatrixXf RobotisManipulator::jacobian(Name tool_name)
+MatrixXr RobotisManipulator::jacobian(Name tool_name)
 {
+  if (kinematics_ == NULL)
+  {
+    MatrixXr jacobian_matrix;
+    manipulator_.jacobian(tool_name, &jacobian_matrix);
+    return jacobian_matrix;
+  }
+
   return kinematics_->jacobian(&manipulator_, tool_name);
 }
 
 void RobotisManipulator::forward()
 {
+  if (kinematics_ == NULL)
+    return manipulator_.forwardKinematics();
+
   return kinematics_->forward(&manipulator_);
 }
 
 void RobotisManipulator::forward(Name first_component_name)
 {
+  if (kinematics_ == NULL)
+    return manipulator_.forwardKinematics(first_component_name);
+
   return kinematics_->forward(&manipulator_, first_component_name);
 }
 
-std::vector<double> RobotisManipulator::inverse(Name tool_name, Pose goal_pose)
+void RobotisManipulator::forward(Name tool_name, const MatrixXr &joint_angle, MatrixXr *tool_position, MatrixXr *tool_orientation)
 {
-  return kinematics_->inverse(&manipulator_, tool_name, goal_pose);
+  manipulator_.forwardKinematics(tool_name, joint_angle, tool_position, tool_orientation);
 }
 
-// ACTUATOR
-std::vector<double> RobotisManipulator::sendAllActuatorAngle(Name actuator_name, std::vector<double> radian_vector)
+void RobotisManipulator::setLazyForwardKinematics(bool lazy)
 {
-  std::vector<double> calc_angle;
-  std::map<Name, Component>::iterator it;
+  manipulator_.setLazyForwardKinematics(lazy);
+}
+
+std::vector<double> RobotisManipulator::inverse(Name tool_name, Pose goal_pose)
+{
+  std::vector<double> goal_angle;
+  solveInverse(tool_name, goal_pose, &goal_angle);
+  return goal_angle;
+}
 
-  uint8_t index = 0;
-  for (it = manipulator_.getIteratorBegin(); it != manipulator_.getIteratorEnd(); it++)
+uint32_t RobotisManipulator::inverse(Name tool_name,
+                                     const std::vector<Pose> &goal_pose,
+                                     std::vector<std::vector<double> > *goal_angle,
+                                     std::vector<InverseResult> *result,
+                                     bool seed_from_previous,
+                                     uint8_t thread_num)
+{
+  if (kinematics_ != NULL)
   {
-    if (manipulator_.getComponentJointId(it->first) != -1)
+    // A user Kinematics is not known to be thread safe; solve the batch in order.
+    // It reports no residual, so check each solution with its own forward kinematics.
+    goal_angle->resize(goal_pose.size());
+    result->resize(goal_pose.size());
+    Manipulator manipulator = manipulator_;
+    size_t dof = manipulator.getAllActiveJointAngle().size();
+    Real tolerance = inverse_solver_.getOption().tolerance;
+    uint32_t converged = 0;
+    for (uint32_t index = 0; index < goal_pose.size(); index++)
     {
-      calc_angle.push_back(radian_vector.at(index++) * manipulator_.getComponentJointCoefficient(it->first));
+      (*goal_angle)[index] = kinematics_->inverse(&manipulator_, tool_name, goal_pose[index]);
+
+      (*result)[index].iteration = 0;
+      (*result)[index].converged = false;
+      (*result)[index].residual = 0.0;
+      if ((*goal_angle)[index].size() != dof)
+        continue;
+
+      manipulator.setAllActiveJointAngle((*goal_angle)[index]);
+      kinematics_->forward(&manipulator);
+      (*result)[index].residual = RM_MATH::poseDifference(goal_pose[index].position, manipulator.getComponentPositionToWorld(tool_name),
+                                                          goal_pose[index].orientation, manipulator.getComponentOrientationToWorld(tool_name)).norm();
+      if ((*result)[index].residual < tolerance)
+      {
+        (*result)[index].converged = true;
+        converged++;
+      }
     }
+    return converged;
+  }
+
+  return inverse_solver_.solve(manipulator_, tool_name, goal_pose, goal_angle, result, seed_from_previous, thread_num);
+}
+
+void RobotisManipulator::setInverseOption(InverseOption option)
+{
+  inverse_solver_.setOption(option);
+}
+
+InverseResult RobotisManipulator::getInverseResult()
+{
+  return inverse_solver_.getResult();
+}
+
+void RobotisManipulator::solveInverse(Name tool_name, Pose goal_pose, std::vector<double> *goal_angle)
+{
+  // The built-in solver starts from the angles held by manipulator_, which the
+  // control loop sets to the previous goal, so consecutive ticks stay warm.
+  solveInverse(&manipulator_, &inverse_solver_, tool_name, goal_pose, goal_angle);
+}
+
+void RobotisManipulator::solveInverse(Manipulator *manipulator, DampedLeastSquares *solver, Name tool_name, Pose goal_pose, std::vector<double> *goal_angle)
+{
+  // A user Kinematics is not known to be thread safe, so it only solves for
+  // manipulator_; the planner's copy always uses the built-in solver.
+  if (kinematics_ != NULL && manipulator == &manipulator_)
+  {
+    *goal_angle = kinematics_->inverse(manipulator, tool_name, goal_pose);
+    return;
   }
-  actuator_.at(actuator_name)->sendAllActuatorAngle(calc_angle);
 
+  solver->solve(manipulator, tool_name, goal_pose, goal_angle);
+}
+
+// ACTUATOR
+std::vector<double> RobotisManipulator::sendAllActuatorAngle(Name actuator_name, const std::vector<double> &radian_vector)
+{
+  std::vector<double> calc_angle;
+
+  sendAllActuatorAngle(actuator_name, radian_vector, &calc_angle);
   return calc_angle;
 }
 
+void RobotisManipulator::sendAllActuatorAngle(Name actuator_name, const std::vector<double> &radian_vector, std::vector<double> *actuator_angle)
+{
+  const std::vector<double> &coefficient = manipulator_.getAllActiveJointCoefficient();
+
+  actuator_angle->resize(coefficient.size());
+  for (uint8_t index = 0; index < coefficient.size(); index++)
+    (*actuator_angle)[index] = radian_vector[index] * coefficient[index];
+
+  actuator_.at(actuator_name)->writeAllActuatorAngle(*actuator_angle);
+}
+
 std::vector<double> RobotisManipulator::sendMultipleActuatorAngle(std::vector<uint8_t> active_joint_id, std::vector<double> radian_vector)
 {
+  const std::vector<double> &coefficient = manipulator_.getAllActiveJointCoefficient();
   std::vector<double> calc_angle;
-  std::map<Name, Component>::iterator it;
 
+  calc_angle.reserve(active_joint_id.size());
   for (uint8_t index = 0; index < active_joint_id.size(); index++)
   {
-    for (it = manipulator_.getIteratorBegin(); it != manipulator_.getIteratorEnd(); it++)
-    {
-      if (active_joint_id.at(index) == manipulator_.getComponentJointId(it->first))
-      {
-        calc_angle.push_back(radian_vector.at(index) * manipulator_.getComponentJointCoefficient(it->first));
-        break;
-      }
-    }
+    int16_t active = manipulator_.getActiveJointIndexById(active_joint_id.at(index));
+    if (active != -1)
+      calc_angle.push_back(radian_vector.at(index) * coefficient[active]);
   }
   return calc_angle;
 }
 
 double RobotisManipulator::sendActuatorAngle(uint8_t active_joint_id, double radian)
 {
-  double calc_angle;
-  std::map<Name, Component>::iterator it;
+  int16_t active = manipulator_.getActiveJointIndexById(active_joint_id);
 
-  for (it = manipulator_.getIteratorBegin(); it != manipulator_.getIteratorEnd(); it++)
-  {
-    if (manipulator_.getComponentJointId(it->first) == active_joint_id)
-    {
-      calc_angle = radian * manipulator_.getComponentJointCoefficient(it->first);
-    }
-  }
+  if (active == -1)
+    return radian;
 
-  return calc_angle;
+  return radian * manipulator_.getAllActiveJointCoefficient()[active];
 }
 
 bool RobotisManipulator::sendActuatorSignal(Name actuator_name, uint8_t active_joint_id, bool onoff)
@@ -516,46 +668,23 @@ bool RobotisManipulator::sendActuatorSignal(Name actuator_name, uint8_t active_j
 
 std::vector<double> RobotisManipulator::receiveAllActuatorAngle(Name actuator_name)
 {
-  std::vector<double> angles = actuator_.at(actuator_name)->receiveAllActuatorAngle();
-  std::vector<uint8_t> active_joint_id = manipulator_.getAllActiveJointID();
-  std::vector<uint8_t> sorted_id = active_joint_id;
-
-  std::vector<double> sorted_angle_vector;
-  sorted_angle_vector.reserve(active_joint_id.size());
-
-  double sorted_angle_array[angles.size()];
-
-  std::sort(sorted_id.begin(), sorted_id.end());
-  for (uint8_t i = 0; i < sorted_id.size(); i++)
-  {
-    for (uint8_t j = 0; j < active_joint_id.size(); j++)
-    {
-      if (sorted_id.at(i) == active_joint_id.at(j))
-      {
-        sorted_angle_array[j] = angles.at(i);
-        break;
-      }
-    }
-  }
-
-  for (uint8_t index = 0; index < active_joint_id.size(); index++)
-    sorted_angle_vector.push_back(sorted_angle_array[index]);
-
   std::vector<double> calc_sorted_angle;
-  std::map<Name, Component>::iterator it;
-
-  uint8_t index = 0;
-  for (it = manipulator_.getIteratorBegin(); it != manipulator_.getIteratorEnd(); it++)
-  {
-    if (manipulator_.getComponentJointId(it->first) != -1)
-    {
-      calc_sorted_angle.push_back(sorted_angle_vector.at(index++) / manipulator_.getComponentJointCoefficient(it->first));
-    }
-  }
 
+  receiveAllActuatorAngle(actuator_name, &calc_sorted_angle);
   return calc_sorted_angle;
 }
 
+void RobotisManipulator::receiveAllActuatorAngle(Name actuator_name, std::vector<double> *joint_angle)
+{
+  std::vector<double> angles = actuator_.at(actuator_name)->receiveAllActuatorAngle();
+  const std::vector<double> &coefficient = manipulator_.getAllActiveJointCoefficient();
+  const std::vector<uint8_t> &receive_order = manipulator_.getAllActiveJointReceiveOrder();
+
+  joint_angle->resize(coefficient.size());
+  for (uint8_t index = 0; index < coefficient.size(); index++)
+    (*joint_angle)[index] = angles.at(receive_order[index]) / coefficient[index];
+}
+
 void RobotisManipulator::actuatorInit(Name actuator_name, const void *arg)
 {
   return actuator_.at(actuator_name)->initActuator(arg);
@@ -628,6 +757,60 @@ void RobotisManipulator::startMoving()
 {
   moving_ = true;
   start_time_ = present_time_;
+  tick_time_ = 0.0;
+  override_time_ = present_time_;
+}
+
+double RobotisManipulator::getTickTime()
+{
+  double elapsed = present_time_ - override_time_;
+  if (elapsed <= 0.0)
+    return tick_time_;
+  override_time_ = present_time_;
+
+  // Integrate the ramping speed over the elapsed time
+  double speed = speed_[0];
+  speed_override_.update(elapsed, &speed_, &speed_rate_, &speed_acceleration_);
+  tick_time_ += std::max(0.5 * (speed + speed_[0]), 0.0) * elapsed;
+  return tick_time_;
+}
+
+void RobotisManipulator::scaleGoalToSpeed(Goal *goal)
+{
+  // The trajectory gives rates per trajectory time tau(t) with dtau/dt = speed:
+  // dq/dt = q' speed, d2q/dt2 = q'' speed^2 + q' dspeed/dt
+  double speed = speed_[0];
+  double speed_rate = speed_rate_[0];
+  if (speed == 1.0 && speed_rate == 0.0)
+    return;
+
+  for (uint8_t index = 0; index < goal->velocity.size(); index++)
+  {
+    goal->acceleration[index] = goal->acceleration[index] * speed * speed + goal->velocity[index] * speed_rate;
+    goal->velocity[index] *= speed;
+  }
+  goal->pose_acc.position = goal->pose_acc.position * Real(speed * speed) + goal->pose_vel.position * Real(speed_rate);
+  goal->pose_acc.orientation = goal->pose_acc.orientation * Real(speed * speed) + goal->pose_vel.orientation * Real(speed_rate);
+  goal->pose_vel.position *= Real(speed);
+  goal->pose_vel.orientation *= Real(speed);
+}
+
+void RobotisManipulator::setSpeedOverride(double speed)
+{
+  std::vector<double> target(1, std::min(std::max(speed, 0.0), 2.0));
+  speed_override_.setTarget(target);
+}
+
+void RobotisManipulator::setSpeedOverrideLimit(double rate, double acceleration, double jerk)
+{
+  speed_override_.setLimit(std::vector<double>(1, rate),
+                           std::vector<double>(1, acceleration),
+                           std::vector<double>(1, jerk));
+}
+
+double RobotisManipulator::getSpeedOverride()
+{
+  return speed_[0];
 }
 
 bool RobotisManipulator::isMoving()
@@ -643,6 +826,604 @@ void RobotisManipulator::makeTrajectory(std::vector<Trajectory> start,std::vecto
     task_trajectory_->init(start, goal, move_time_, control_time_);
 }
 
+void RobotisManipulator::setMotionQueue(uint8_t capacity, double blend_time)
+{
+  motion_queue_.clear();
+  motion_queue_.resize(capacity);
+  motion_queue_head_ = 0;
+  motion_queue_size_ = 0;
+  blend_time_ = blend_time;
+}
+
+void RobotisManipulator::clearMotionQueue()
+{
+  motion_queue_head_ = 0;
+  motion_queue_size_ = 0;
+}
+
+uint8_t RobotisManipulator::getMotionQueueSize()
+{
+  return motion_queue_size_;
+}
+
+bool RobotisManipulator::isMotionQueueFull()
+{
+  return motion_queue_size_ == motion_queue_.size();
+}
+
+bool RobotisManipulator::isMotionQueued()
+{
+  return !motion_queue_.empty() && !dequeuing_ && (moving_ || motion_queue_size_ > 0);
+}
+
+Motion RobotisManipulator::makeMotion(Name trajectory_type, Name tool_name, double move_time)
+{
+  Motion motion;
+  motion.trajectory_type = trajectory_type;
+  motion.tool_name = tool_name;
+  motion.move_time = move_time;
+  motion.use_goal_pose = false;
+  motion.object = 0;
+  motion.option = 0.0;
+  motion.meter = ZERO_VECTOR;
+  motion.use_meter = false;
+  return motion;
+}
+
+bool RobotisManipulator::pushMotion(const Motion &motion)
+{
+  if (isMotionQueueFull())
+    return false;
+
+  motion_queue_[(motion_queue_head_ + motion_queue_size_) % motion_queue_.size()] = motion;
+  motion_queue_size_++;
+  return true;
+}
+
+void RobotisManipulator::startQueuedMotion()
+{
+  Motion &motion = motion_queue_[motion_queue_head_];
+
+  if (moving_)
+  {
+    // Only joint space motions start from the full previous goal state
+    // (position, velocity and acceleration), so only they can take over early.
+    bool joint_space = (trajectory_type_ == JOINT_TRAJECTORY || trajectory_type_ == VIA_POINT_TRAJECTORY) &&
+                       (motion.trajectory_type == JOINT_TRAJECTORY || motion.trajectory_type == VIA_POINT_TRAJECTORY);
+    double remaining_time = move_time_ - getTickTime();
+
+    if (!joint_space || remaining_time > blend_time_)
+      return;
+  }
+
+  motion_queue_head_ = (motion_queue_head_ + 1) % motion_queue_.size();
+  motion_queue_size_--;
+
+  dequeuing_ = true;
+  startMotion(motion);
+  dequeuing_ = false;
+}
+
+void RobotisManipulator::startMotion(const Motion &motion)
+{
+  switch (motion.trajectory_type)
+  {
+  case JOINT_TRAJECTORY:
+    if (motion.use_goal_pose)
+      setJointTrajectory(motion.tool_name, motion.goal_pose, motion.move_time);
+    else if (motion.goal_position.empty())
+      wait(motion.move_time);
+    else
+      setJointTrajectory(motion.goal_position, motion.move_time);
+    break;
+  case TASK_TRAJECTORY:
+    setTaskTrajectory(motion.tool_name, motion.goal_pose, motion.move_time);
+    break;
+  case DRAWING:
+    if (motion.use_meter)
+      setDrawing(motion.tool_name, motion.object, motion.move_time, motion.meter);
+    else
+      setDrawing(motion.tool_name, motion.object, motion.move_time, motion.option);
+    break;
+  case VIA_POINT_TRAJECTORY:
+    setViaPointTrajectory(motion.via_point, motion.via_time, motion.move_time);
+    break;
+  }
+}
+
+void RobotisManipulator::setCommandRing(uint8_t capacity)
+{
+  for (uint32_t index = 0; index < command_ring_.size(); index++)
+  {
+    delete command_ring_[index].joint_trajectory;
+    delete command_ring_[index].task_trajectory;
+    delete command_ring_[index].via_point_trajectory;
+  }
+  command_ring_.clear();
+  command_head_ = 0;
+  command_tail_ = 0;
+  if (capacity == 0)
+    return;
+
+  uint8_t dof = manipulator_.getDOF();
+  command_ring_.resize(capacity + 1);
+  for (uint32_t index = 0; index < command_ring_.size(); index++)
+  {
+    command_ring_[index].joint_trajectory = new JointTrajectory(dof);
+    command_ring_[index].task_trajectory = new TaskTrajectory();
+    command_ring_[index].via_point_trajectory = new ViaPointTrajectory(dof);
+    command_ring_[index].goal_position.reserve(dof);
+  }
+
+  // The planner works on its own copy of the model, so it never touches what a tick reads
+  planner_manipulator_ = manipulator_;
+  planner_solver_ = inverse_solver_;
+  planner_position_ = previous_goal_.position;
+}
+
+Command *RobotisManipulator::beginCommand(Name trajectory_type, Name tool_name, double move_time)
+{
+  if (command_ring_.empty())
+    return NULL;
+
+  uint32_t tail = command_tail_.load(std::memory_order_relaxed);
+  if ((tail + 1) % command_ring_.size() == command_head_.load(std::memory_order_acquire))
+    return NULL;
+
+  // The slot belongs to the planner until postCommand() publishes it
+  Command *command = &command_ring_[tail];
+  command->trajectory_type = trajectory_type;
+  command->tool_name = tool_name;
+  command->move_time = move_time;
+  command->object = 0;
+  command->tool_value = 0.0;
+  command->joint_table.clear();
+  command->joint_table_step = 0.0;
+  return command;
+}
+
+void RobotisManipulator::postCommand()
+{
+  uint32_t tail = command_tail_.load(std::memory_order_relaxed);
+  command_tail_.store((tail + 1) % command_ring_.size(), std::memory_order_release);
+}
+
+void RobotisManipulator::adoptCommand()
+{
+  uint32_t head = command_head_.load(std::memory_order_relaxed);
+  while (head != command_tail_.load(std::memory_order_acquire))
+  {
+    // Each command is planned from the end of the one before, so it waits for
+    // the present motion to finish. A new streaming target retargets at once.
+    Command *command = &command_ring_[head];
+    bool retarget = (command->trajectory_type == STREAMING_TRAJECTORY && trajectory_type_ == STREAMING_TRAJECTORY);
+    if (moving_ && !retarget)
+      break;
+
+    startCommand(command);
+    head = (head + 1) % command_ring_.size();
+    command_head_.store(head, std::memory_order_release);
+  }
+}
+
+void RobotisManipulator::startCommand(Command *command)
+{
+  switch (command->trajectory_type)
+  {
+  case STREAMING_TRAJECTORY:
+    setStreamingTarget(command->goal_position);
+    return;
+  case TOOL_MOVE:
+    toolMove(command->tool_name, command->tool_value);
+    return;
+  case JOINT_TRAJECTORY:
+    std::swap(joint_trajectory_, command->joint_trajectory);
+    break;
+  case TASK_TRAJECTORY:
+    std::swap(task_trajectory_, command->task_trajectory);
+    task_start_orientation_ = command->task_start_orientation;
+    task_rotation_axis_ = command->task_rotation_axis;
+    break;
+  case VIA_POINT_TRAJECTORY:
+    std::swap(via_point_trajectory_, command->via_point_trajectory);
+    break;
+  case DRAWING:
+    object_ = command->object;
+    break;
+  }
+
+  // Motions without a joint table swap in the slot's empty one
+  joint_table_.swap(command->joint_table);
+  joint_table_step_ = command->joint_table_step;
+  trajectory_type_ = command->trajectory_type;
+  setMoveTime(command->move_time);
+  startMoving();
+}
+
+Pose RobotisManipulator::getPlannerPose(Name tool_name)
+{
+  planner_manipulator_.setAllActiveJointAngle(planner_position_);
+  planner_manipulator_.forwardKinematics();
+  return planner_manipulator_.getComponentPoseToWorld(tool_name);
+}
+
+void RobotisManipulator::makeCommandTable(Command *command)
+{
+  uint8_t dof = planner_position_.size();
+  uint32_t step = std::max(uint32_t(ceil(command->move_time / control_time_ - 1e-6)), uint32_t(1));
+  command->joint_table_step = command->move_time / step;
+  command->joint_table.resize((step + 1) * dof);
+
+  std::vector<double> position, velocity, acceleration, angle(dof);
+  Pose sample_pose;
+
+  // Seeded like makeJointTable(), from the sample before
+  planner_manipulator_.setAllActiveJointAngle(planner_position_);
+  for (uint32_t row = 0; row <= step; row++)
+  {
+    double tick = row * command->joint_table_step;
+    if (command->trajectory_type == TASK_TRAJECTORY)
+    {
+      command->task_trajectory->getState(tick, &position, &velocity, &acceleration);
+      sample_pose.position = RM_MATH::makeVector3(position[0], position[1], position[2]);
+      sample_pose.orientation = RM_MATH::rodriguesRotationMatrix(command->task_rotation_axis, position[3]) *
+                                command->task_start_orientation;
+    }
+    else
+    {
+      sample_pose = getPoseForDrawing(command->object, tick);
+    }
+
+    solveInverse(&planner_manipulator_, &planner_solver_, command->tool_name, sample_pose, &angle);
+    planner_manipulator_.setAllActiveJointAngle(angle);
+    std::copy(angle.begin(), angle.end(), command->joint_table.begin() + row * dof);
+  }
+}
+
+bool RobotisManipulator::postJointTrajectory(std::vector<double> goal_position, double move_time)
+{
+  Command *command = beginCommand(JOINT_TRAJECTORY, 0, move_time);
+  if (command == NULL || goal_position.size() != planner_position_.size())
+    return false;
+
+  // Posted motions start at rest where the motion before them ends
+  std::vector<Trajectory> start(planner_position_.size()), goal(planner_position_.size());
+  for (uint8_t index = 0; index < start.size(); index++)
+  {
+    start[index].position = planner_position_[index];
+    goal[index].position = goal_position[index];
+  }
+
+  command->move_time = limitMoveTime(move_time, getFastestMoveTime(&planner_manipulator_, planner_position_, goal_position));
+  command->joint_trajectory->setProfile(velocity_profile_, acceleration_ratio_, jerk_ratio_);
+  command->joint_trajectory->init(start, goal, command->move_time, control_time_);
+
+  planner_position_ = goal_position;
+  postCommand();
+  return true;
+}
+
+bool RobotisManipulator::postJointTrajectory(Name tool_name, Pose goal_pose, double move_time)
+{
+  std::vector<double> goal_position;
+  planner_manipulator_.setAllActiveJointAngle(planner_position_);
+  solveInverse(&planner_manipulator_, &planner_solver_, tool_name, goal_pose, &goal_position);
+  return postJointTrajectory(goal_position, move_time);
+}
+
+bool RobotisManipulator::postTaskTrajectory(Name tool_name, Pose goal_pose, double move_time)
+{
+  Command *command = beginCommand(TASK_TRAJECTORY, tool_name, move_time);
+  if (command == NULL)
+    return false;
+
+  Pose start_pose = getPlannerPose(tool_name);
+  std::vector<Trajectory> start(4), goal(4);
+  for (uint8_t index = 0; index < 3; index++)
+  {
+    start[index].position = start_pose.position[index];
+    goal[index].position = goal_pose.position[index];
+  }
+
+  // Same geodesic orientation as setTaskTrajectory()
+  command->task_start_orientation = start_pose.orientation;
+  Vector3r rotation_vector = start_pose.orientation *
+                             RM_MATH::matrixLogarithm(start_pose.orientation.transpose() * goal_pose.orientation);
+  Real rotation_angle = rotation_vector.norm();
+  command->task_rotation_axis = (rotation_angle > 0.0) ? Vector3r(rotation_vector / rotation_angle) : Vector3r::Zero();
+  goal[3].position = rotation_angle;
+
+  command->move_time = limitMoveTime(move_time, getFastestMoveTime(&planner_manipulator_, &planner_solver_, planner_position_,
+                                                                   tool_name, goal_pose));
+  command->task_trajectory->setProfile(velocity_profile_, acceleration_ratio_, jerk_ratio_);
+  command->task_trajectory->init(start, goal, command->move_time, control_time_);
+  makeCommandTable(command);
+
+  planner_position_.assign(command->joint_table.end() - planner_position_.size(), command->joint_table.end());
+  postCommand();
+  return true;
+}
+
+bool RobotisManipulator::postViaPointTrajectory(std::vector<std::vector<double> > via_point, std::vector<double> via_time, double move_time)
+{
+  Command *command = beginCommand(VIA_POINT_TRAJECTORY, 0, move_time);
+  if (command == NULL)
+    return false;
+
+  std::vector<Trajectory> start(planner_position_.size());
+  for (uint8_t index = 0; index < start.size(); index++)
+    start[index].position = planner_position_[index];
+
+  if (!command->via_point_trajectory->init(start, via_point, via_time, move_time))
+    return false;
+  command->move_time = command->via_point_trajectory->getMoveTime();
+
+  planner_position_ = via_point.back();
+  postCommand();
+  return true;
+}
+
+bool RobotisManipulator::postDrawing(Name tool_name, int object, double move_time, double option)
+{
+  return postDrawing(tool_name, object, move_time, option, NULL);
+}
+
+bool RobotisManipulator::postDrawing(Name tool_name, int object, double move_time, Vector3r meter)
+{
+  return postDrawing(tool_name, object, move_time, 0.0, &meter);
+}
+
+bool RobotisManipulator::postDrawing(Name tool_name, int object, double move_time, double option, const Vector3r *meter)
+{
+  Command *command = beginCommand(DRAWING, tool_name, move_time);
+  if (command == NULL)
+    return false;
+  command->object = object;
+
+  // Set up like setDrawing(), but without drawInit(), which sets the move time the tick reads.
+  // The control loop plays the joint table only, so the drawing is the planner's to set up.
+  Drawing *drawing = drawing_.at(object);
+  Pose start_pose = getPlannerPose(tool_name);
+  double init_arg[2] = {move_time, ACTUATOR_CONTROL_TIME};
+  void *p_init_arg = init_arg;
+  if (meter == NULL)
+  {
+    drawing->initDraw(p_init_arg);
+    drawing->setRadius(option);
+    drawing->setStartPose(start_pose);
+    drawing->setAngularStartPosition(0.0);
+  }
+  else
+  {
+    Pose end_pose = start_pose;
+    end_pose.position += *meter;
+    drawing->setStartPose(start_pose);
+    drawing->setEndPose(end_pose);
+    drawing->initDraw(p_init_arg);
+  }
+  makeCommandTable(command);
+
+  planner_position_.assign(command->joint_table.end() - planner_position_.size(), command->joint_table.end());
+  postCommand();
+  return true;
+}
+
+bool RobotisManipulator::postStreamingTarget(const std::vector<double> &goal_position)
+{
+  Command *command = beginCommand(STREAMING_TRAJECTORY, 0, 0.0);
+  if (command == NULL || goal_position.size() != planner_position_.size())
+    return false;
+
+  command->goal_position = goal_position;
+  planner_position_ = goal_position;
+  postCommand();
+  return true;
+}
+
+bool RobotisManipulator::postToolMove(Name tool_name, double tool_value)
+{
+  Command *command = beginCommand(TOOL_MOVE, tool_name, 0.0);
+  if (command == NULL)
+    return false;
+
+  command->tool_value = tool_value;
+  postCommand();
+  return true;
+}
+
+bool RobotisManipulator::postWait(double wait_time)
+{
+  Command *command = beginCommand(JOINT_TRAJECTORY, 0, wait_time);
+  if (command == NULL)
+    return false;
+
+  std::vector<Trajectory> hold(planner_position_.size());
+  for (uint8_t index = 0; index < hold.size(); index++)
+    hold[index].position = planner_position_[index];
+
+  command->move_time = limitMoveTime(wait_time, 0.0);
+  command->joint_trajectory->setProfile(velocity_profile_, acceleration_ratio_, jerk_ratio_);
+  command->joint_trajectory->init(hold, hold, command->move_time, control_time_);
+
+  postCommand();
+  return true;
+}
+
+void RobotisManipulator::setTaskPrecompute(bool precompute)
+{
+  precompute_task_ = precompute;
+}
+
+bool RobotisManipulator::getTaskPrecompute()
+{
+  return precompute_task_;
+}
+
+void RobotisManipulator::setVelocityProfile(Name profile_type, double acceleration_ratio, double jerk_ratio)
+{
+  velocity_profile_ = profile_type;
+  acceleration_ratio_ = acceleration_ratio;
+  jerk_ratio_ = jerk_ratio;
+
+  // The trajectories pick it up in initTrajectory when they do not exist yet
+  if (joint_trajectory_ != NULL)
+    joint_trajectory_->setProfile(profile_type, acceleration_ratio, jerk_ratio);
+  if (task_trajectory_ != NULL)
+    task_trajectory_->setProfile(profile_type, acceleration_ratio, jerk_ratio);
+}
+
+Name RobotisManipulator::getVelocityProfile()
+{
+  return velocity_profile_;
+}
+
+double RobotisManipulator::getFastestMoveTime(std::vector<double> goal_position)
+{
+  return getFastestMoveTime(&manipulator_, previous_goal_.position, goal_position);
+}
+
+double RobotisManipulator::getFastestMoveTime(Name tool_name, Pose goal_pose)
+{
+  return getFastestMoveTime(&manipulator_, &inverse_solver_, previous_goal_.position, tool_name, goal_pose);
+}
+
+double RobotisManipulator::getFastestMoveTime(Manipulator *manipulator, const std::vector<double> &start_position, const std::vector<double> &goal_position)
+{
+  std::vector<double> max_velocity, max_acceleration, max_jerk;
+  manipulator->getAllActiveJointMotionLimit(&max_velocity, &max_acceleration, &max_jerk);
+
+  // Peaks of a rest to rest move over distance d in time T are
+  // velocity cv d/T, acceleration ca d/T^2 and jerk cj d/T^3
+  double cv, ca, cj;
+  getProfilePeak(&cv, &ca, &cj);
+
+  double fastest_move_time = 0.0;
+  for (uint8_t index = 0; index < max_velocity.size(); index++)
+  {
+    double distance = fabs(goal_position.at(index) - start_position.at(index));
+
+    fastest_move_time = std::max(fastest_move_time, cv * distance / max_velocity[index]);
+    fastest_move_time = std::max(fastest_move_time, sqrt(ca * distance / max_acceleration[index]));
+    if (cj > 0.0)
+      fastest_move_time = std::max(fastest_move_time, cbrt(cj * distance / max_jerk[index]));
+  }
+  return fastest_move_time;
+}
+
+double RobotisManipulator::getFastestMoveTime(Manipulator *manipulator, DampedLeastSquares *solver, const std::vector<double> &start_position,
+                                              Name tool_name, Pose goal_pose)
+{
+  std::vector<double> max_velocity, max_acceleration, max_jerk;
+  manipulator->getAllActiveJointMotionLimit(&max_velocity, &max_acceleration, &max_jerk);
+
+  bool limited = false;
+  for (uint8_t index = 0; index < max_velocity.size(); index++)
+  {
+    if (max_velocity[index] < DBL_MAX || max_acceleration[index] < DBL_MAX || max_jerk[index] < DBL_MAX)
+      limited = true;
+  }
+  if (!limited)
+    return 0.0;
+
+  // The tool follows a straight line with the velocity profile s(tau), tau = t / T.
+  // Sampling the joint path q(tau) through inverse kinematics gives the derivatives
+  // with respect to tau; the time T scales them by 1/T, 1/T^2 and 1/T^3.
+  const uint8_t sample_num = 50;
+  const double d_tau = 1.0 / sample_num;
+
+  MinimumJerkProfile minimum_jerk;
+  TrapezoidalProfile trapezoidal;
+  DoubleSProfile double_s;
+  VelocityProfile *profile = &minimum_jerk;
+  minimum_jerk.init(1.0);
+  if (velocity_profile_ == TRAPEZOIDAL_PROFILE)
+  {
+    trapezoidal.init(1.0, acceleration_ratio_);
+    profile = &trapezoidal;
+  }
+  else if (velocity_profile_ == DOUBLE_S_PROFILE)
+  {
+    double_s.init(1.0, acceleration_ratio_, jerk_ratio_ * acceleration_ratio_);
+    profile = &double_s;
+  }
+
+  manipulator->setAllActiveJointAngle(start_position);
+  manipulator->forwardKinematics();
+  Vector3r start_tool_position = manipulator->getComponentPositionToWorld(tool_name);
+  Matrix3r start_orientation = manipulator->getComponentOrientationToWorld(tool_name);
+  Vector3r rotation_vector = start_orientation * RM_MATH::matrixLogarithm(start_orientation.transpose() * goal_pose.orientation);
+  Real rotation_angle = rotation_vector.norm();
+  Vector3r rotation_axis = (rotation_angle > 0.0) ? Vector3r(rotation_vector / rotation_angle) : Vector3r::Zero();
+
+  std::vector<std::vector<double> > q(sample_num + 1);
+  Pose sample_pose = goal_pose;
+  for (uint8_t sample = 0; sample <= sample_num; sample++)
+  {
+    double s, ds, dds;
+    profile->getState(sample * d_tau, &s, &ds, &dds);
+
+    sample_pose.position = start_tool_position + (goal_pose.position - start_tool_position) * s;
+    sample_pose.orientation = RM_MATH::rodriguesRotationMatrix(rotation_axis, rotation_angle * s) * start_orientation;
+    solveInverse(manipulator, solver, tool_name, sample_pose, &q[sample]);
+    manipulator->setAllActiveJointAngle(q[sample]);
+  }
+  manipulator->setAllActiveJointAngle(start_position);
+
+  double fastest_move_time = 0.0;
+  for (uint8_t index = 0; index < max_velocity.size(); index++)
+  {
+    for (uint8_t sample = 1; sample + 2 <= sample_num; sample++)
+    {
+      double q0 = q[sample - 1][index], q1 = q[sample][index], q2 = q[sample + 1][index], q3 = q[sample + 2][index];
+      double velocity = fabs(q2 - q0) / (2.0 * d_tau);
+      double acceleration = fabs(q2 - 2.0 * q1 + q0) / (d_tau * d_tau);
+      double jerk = fabs(q3 - 3.0 * q2 + 3.0 * q1 - q0) / (d_tau * d_tau * d_tau);
+
+      fastest_move_time = std::max(fastest_move_time, velocity / max_velocity[index]);
+      fastest_move_time = std::max(fastest_move_time, sqrt(acceleration / max_acceleration[index]));
+      // The acceleration of a trapezoid steps, so its jerk is not bounded
+      if (velocity_profile_ != TRAPEZOIDAL_PROFILE)
+        fastest_move_time = std::max(fastest_move_time, cbrt(jerk / max_jerk[index]));
+    }
+  }
+  return fastest_move_time;
+}
+
+void RobotisManipulator::getProfilePeak(double *velocity, double *acceleration, double *jerk)
+{
+  if (velocity_profile_ == MINIMUM_JERK_PROFILE)
+  {
+    *velocity = 1.875;
+    *acceleration = 5.7735;
+    *jerk = 60.0;
+    return;
+  }
+
+  // Unit move in unit time with the profile's phase times
+  DoubleSProfile profile;
+  if (velocity_profile_ == TRAPEZOIDAL_PROFILE)
+    profile.init(1.0, acceleration_ratio_, 0.0);
+  else
+    profile.init(1.0, acceleration_ratio_, jerk_ratio_ * acceleration_ratio_);
+
+  double acceleration_time = profile.getAccelerationTime();
+  double jerk_time = profile.getJerkTime();
+
+  *velocity = 1.0 / (1.0 - acceleration_time);
+  *acceleration = *velocity / (acceleration_time - jerk_time);
+  *jerk = (jerk_time > 0.0) ? *acceleration / jerk_time : 0.0;
+}
+
+double RobotisManipulator::limitMoveTime(double move_time, double fastest_move_time)
+{
+  if (move_time >= fastest_move_time && move_time >= control_time_)
+    return move_time;
+
+  // Round up to whole control periods; the trajectory rounds its move time down
+  double step = ceil(std::max(fastest_move_time, control_time_) / control_time_);
+  return (step + 1e-6) * control_time_;
+}
+
 void RobotisManipulator::setStartTrajectory(Trajectory trajectory)
 {
   if(trajectory_type_ == JOINT_TRAJECTORY)
@@ -698,8 +1479,13 @@ double RobotisManipulator::toolMove(Name tool_name, double tool_value)
   return sendActuatorAngle(manipulator_.getComponentToolId(tool_name), calc_value);
 }
 
-void RobotisManipulator::wait(double wait_time)
+bool RobotisManipulator::wait(double wait_time)
 {
+  if (isMotionQueued())
+  {
+    return pushMotion(makeMotion(JOINT_TRAJECTORY, 0, wait_time));
+  }
+
   Trajectory start;
   Trajectory goal;
 
@@ -725,9 +1511,10 @@ void RobotisManipulator::wait(double wait_time)
     goal_joint_trajectory_.push_back(goal);
   }
 
-  setMoveTime(wait_time);
+  setMoveTime(limitMoveTime(wait_time, 0.0));
   makeTrajectory(start_joint_trajectory_, goal_joint_trajectory_);
   startMoving();
+  return true;
 }
 
 
@@ -751,134 +1538,258 @@ void RobotisManipulator::setEndPoseForDrawing(Name name, Pose end_pose)
 }
 
 
-std::vector<double> RobotisManipulator::controlLoop(double present_time, Name tool_name, Name actuator_name)
+const std::vector<double> &RobotisManipulator::controlLoop(double present_time, Name tool_name, Name actuator_name)
 {
   setPresentTime(present_time);
-  setAllActiveJointAngle(getPreviousGoalPosition());
-  forward(getWorldChildName());
+  adoptCommand();
+  setAllActiveJointAngle(previous_goal_.position);
+  if (!manipulator_.getLazyForwardKinematics())
+    forward(getWorldChildName());
 
   if(moving_)
   {
-    Goal joint_goal_states;
-
     switch(trajectory_type_)
     {
     case JOINT_TRAJECTORY:
-      joint_goal_states = getJointAngleFromJointTraj();
+      getJointAngleFromJointTraj(&goal_);
       break;
     case TASK_TRAJECTORY:
-      joint_goal_states = getJointAngleFromTaskTraj(tool_name);
+      getJointAngleFromTaskTraj(tool_name, &goal_);
       break;
     case DRAWING:
-      joint_goal_states = getJointAngleFromDrawing(tool_name);
+      getJointAngleFromDrawing(tool_name, &goal_);
+      break;
+    case VIA_POINT_TRAJECTORY:
+      getJointAngleFromViaPointTraj(&goal_);
+      break;
+    case STREAMING_TRAJECTORY:
+      getJointAngleFromStreamingTraj(&goal_);
       break;
     }
+    scaleGoalToSpeed(&goal_);
     ///////////////////send target angle////////////////////////////////
-    previous_goal_ = joint_goal_states;
-    return sendAllActuatorAngle(actuator_name, joint_goal_states.position);
+    previous_goal_ = goal_;
+    if (motion_queue_size_ > 0)
+      startQueuedMotion();
+    sendAllActuatorAngle(actuator_name, goal_.position, &actuator_angle_);
+    return actuator_angle_;
     /////////////////////////////////////////////////////////////////////
   }
 
-  return {};
+  actuator_angle_.clear();
+  return actuator_angle_;
 }
 
 Goal RobotisManipulator::getJointAngleFromJointTraj()
 {
-  double tick_time = present_time_ - start_time_;
   Goal joint_goal_states;
+  getJointAngleFromJointTraj(&joint_goal_states);
+  return joint_goal_states;
+}
 
-  if(tick_time < move_time_)
+Goal RobotisManipulator::getJointAngleFromTaskTraj(Name tool_name)
+{
+  Goal joint_goal_states;
+  joint_goal_states.velocity.resize(manipulator_.getDOF());
+  joint_goal_states.acceleration.resize(manipulator_.getDOF());
+  getJointAngleFromTaskTraj(tool_name, &joint_goal_states);
+  return joint_goal_states;
+}
+
+Goal RobotisManipulator::getJointAngleFromDrawing(Name tool_name)
+{
+  Goal joint_goal_states;
+  joint_goal_states.velocity.resize(manipulator_.getDOF());
+  joint_goal_states.acceleration.resize(manipulator_.getDOF());
+  getJointAngleFromDrawing(tool_name, &joint_goal_states);
+  return joint_goal_states;
+}
+
+void RobotisManipulator::getJointAngleFromJointTraj(Goal *joint_goal_states)
+{
+  double tick_time = getTickTime();
+
+  if(tick_time >= move_time_)
   {
-    joint_goal_states.position = joint_trajectory_->getPosition(tick_time);
-    joint_goal_states.velocity = joint_trajectory_->getVelocity(tick_time);
-    joint_goal_states.acceleration = joint_trajectory_->getAcceleration(tick_time);
+    tick_time = move_time_;
+    moving_   = false;
+    start_time_ = present_time_;
   }
-  else
+
+  joint_trajectory_->getState(tick_time,
+                              &joint_goal_states->position,
+                              &joint_goal_states->velocity,
+                              &joint_goal_states->acceleration);
+}
+
+void RobotisManipulator::getJointAngleFromTaskTraj(Name tool_name, Goal *joint_goal_states)
+{
+  double tick_time = getTickTime();
+
+  if(tick_time >= move_time_)
   {
-    joint_goal_states.position = joint_trajectory_->getPosition(move_time_);
-    joint_goal_states.velocity= joint_trajectory_->getVelocity(move_time_);
-    joint_goal_states.acceleration = joint_trajectory_->getAcceleration(move_time_);
+    tick_time = move_time_;
     moving_   = false;
     start_time_ = present_time_;
   }
-  return joint_goal_states;
+
+  getTaskPose(tick_time, joint_goal_states);
+  if (!joint_table_.empty())
+  {
+    getJointAngleFromTable(tick_time, joint_goal_states);
+    return;
+  }
+
+  std::fill(joint_goal_states->velocity.begin(), joint_goal_states->velocity.end(), 0.0);
+  std::fill(joint_goal_states->acceleration.begin(), joint_goal_states->acceleration.end(), 0.0);
+  solveInverse(tool_name, joint_goal_states->pose, &joint_goal_states->position);
 }
 
-Goal RobotisManipulator::getJointAngleFromTaskTraj(Name tool_name)
+void RobotisManipulator::getTaskPose(double tick, Goal *goal)
 {
-  double tick_time = present_time_ - start_time_;
-  Goal joint_goal_states;
-  joint_goal_states.velocity.resize(4);
-  joint_goal_states.acceleration.resize(4);
+  task_trajectory_->getState(tick, &task_position_, &task_velocity_, &task_acceleration_);
+  for (uint8_t index = 0; index < 3; index++)
+  {
+    goal->pose.position(index) = task_position_[index];
+    goal->pose_vel.position(index) = task_velocity_[index];
+    goal->pose_acc.position(index) = task_acceleration_[index];
+  }
 
-  if(tick_time < move_time_)
+  // R(t) = exp([k] theta(t)) R0 about the fixed world axis k, so the angular
+  // velocity is k dtheta and the angular acceleration k ddtheta
+  Matrix3r angular_velocity = RM_MATH::skewSymmetricMatrix(task_rotation_axis_ * task_velocity_[3]);
+  Matrix3r angular_acceleration = RM_MATH::skewSymmetricMatrix(task_rotation_axis_ * task_acceleration_[3]);
+  goal->pose.orientation = RM_MATH::rodriguesRotationMatrix(task_rotation_axis_, task_position_[3]) * task_start_orientation_;
+  goal->pose_vel.orientation = angular_velocity * goal->pose.orientation;
+  goal->pose_acc.orientation = (angular_acceleration + angular_velocity * angular_velocity) * goal->pose.orientation;
+}
+
+void RobotisManipulator::makeJointTable(Name tool_name)
+{
+  uint8_t dof = manipulator_.getDOF();
+  uint32_t step = std::max(uint32_t(ceil(move_time_ / control_time_ - 1e-6)), uint32_t(1));
+  joint_table_step_ = move_time_ / step;
+  joint_table_.resize((step + 1) * dof);
+
+  Goal sample = previous_goal_;
+  Pose sample_pose;
+  std::vector<double> angle(dof);
+
+  // Each sample is seeded from the one before, like the control loop would do
+  manipulator_.setAllActiveJointAngle(previous_goal_.position);
+  for (uint32_t row = 0; row <= step; row++)
   {
-    std::vector<double> temp = task_trajectory_->getPosition(tick_time);
-    Pose goal_pose;
-    goal_pose.position(0) = temp.at(0); goal_pose.position(1) = temp.at(1); goal_pose.position(2) = temp.at(2);
-    goal_pose.orientation = previous_goal_.pose.orientation;
-    joint_goal_states.pose = goal_pose;
-
-    temp = task_trajectory_->getVelocity(tick_time);
-    Pose goal_pose_vel;
-    goal_pose_vel.position(0) = temp.at(0); goal_pose_vel.position(1) = temp.at(1); goal_pose_vel.position(2) = temp.at(2);
-    joint_goal_states.pose_vel = goal_pose_vel;
-
-    temp = task_trajectory_->getAcceleration(tick_time);
-    Pose goal_pose_acc;
-    goal_pose_acc.position(0) = temp.at(0); goal_pose_acc.position(1) = temp.at(1); goal_pose_acc.position(2) = temp.at(2);
-    joint_goal_states.pose_acc = goal_pose_acc;
-
-    joint_goal_states.position = kinematics_->inverse(&manipulator_, tool_name, goal_pose);
+    double tick = row * joint_table_step_;
+    if (trajectory_type_ == TASK_TRAJECTORY)
+    {
+      getTaskPose(tick, &sample);
+      sample_pose = sample.pose;
+    }
+    else
+    {
+      sample_pose = getPoseForDrawing(object_, tick);
+    }
+
+    solveInverse(tool_name, sample_pose, &angle);
+    manipulator_.setAllActiveJointAngle(angle);
+    std::copy(angle.begin(), angle.end(), joint_table_.begin() + row * dof);
   }
-  else
+  manipulator_.setAllActiveJointAngle(previous_goal_.position);
+}
+
+void RobotisManipulator::getJointAngleFromTable(double tick, Goal *joint_goal_states)
+{
+  uint8_t dof = manipulator_.getDOF();
+  uint32_t last_row = joint_table_.size() / dof - 1;
+
+  double index = tick / joint_table_step_;
+  uint32_t row = std::min(uint32_t(index), last_row - 1);
+  double ratio = std::min(index - row, 1.0);
+
+  const double *angle = &joint_table_[row * dof];
+  const double *next_angle = angle + dof;
+  for (uint8_t joint = 0; joint < dof; joint++)
+  {
+    double difference = next_angle[joint] - angle[joint];
+    joint_goal_states->position[joint] = angle[joint] + difference * ratio;
+    joint_goal_states->velocity[joint] = difference / joint_table_step_;
+    joint_goal_states->acceleration[joint] = 0.0;
+  }
+}
+
+void RobotisManipulator::getJointAngleFromDrawing(Name tool_name, Goal *joint_goal_states)
+{
+  double tick_time = getTickTime();
+
+  if(tick_time >= move_time_)
   {
-    std::vector<double> temp = task_trajectory_->getPosition(move_time_);
-    Pose goal_pose;
-    goal_pose.position(0) = temp.at(0); goal_pose.position(1) = temp.at(1); goal_pose.position(2) = temp.at(2);
-    goal_pose.orientation = previous_goal_.pose.orientation;
-    joint_goal_states.pose = goal_pose;
-
-    temp = task_trajectory_->getVelocity(move_time_);
-    Pose goal_pose_vel;
-    goal_pose_vel.position(0) = temp.at(0); goal_pose_vel.position(1) = temp.at(1); goal_pose_vel.position(2) = temp.at(2);
-    joint_goal_states.pose_vel = goal_pose_vel;
-
-    temp = task_trajectory_->getAcceleration(move_time_);
-    Pose goal_pose_acc;
-    goal_pose_acc.position(0) = temp.at(0); goal_pose_acc.position(1) = temp.at(1); goal_pose_acc.position(2) = temp.at(2);
-    joint_goal_states.pose_acc = goal_pose_acc;
-
-    joint_goal_states.position = kinematics_->inverse(&manipulator_, tool_name, goal_pose);
+    tick_time = move_time_;
     moving_   = false;
     start_time_ = present_time_;
   }
-  return joint_goal_states;
 
+  // The planner may already be setting up the drawing for a posted command,
+  // so a precomputed drawing never reads it again
+  if (!joint_table_.empty())
+  {
+    getJointAngleFromTable(tick_time, joint_goal_states);
+    return;
+  }
+
+  drawing_.at(object_)->getState(tick_time,
+                                 &joint_goal_states->pose,
+                                 &joint_goal_states->pose_vel,
+                                 &joint_goal_states->pose_acc);
+
+  std::fill(joint_goal_states->velocity.begin(), joint_goal_states->velocity.end(), 0.0);
+  std::fill(joint_goal_states->acceleration.begin(), joint_goal_states->acceleration.end(), 0.0);
+  solveInverse(tool_name, joint_goal_states->pose, &joint_goal_states->position);
 }
-Goal RobotisManipulator::getJointAngleFromDrawing(Name tool_name)
+
+void RobotisManipulator::getJointAngleFromViaPointTraj(Goal *joint_goal_states)
 {
-  double tick_time = present_time_ - start_time_;
-  Goal joint_goal_states;
-  joint_goal_states.velocity.resize(4);
-  joint_goal_states.acceleration.resize(4);
+  double tick_time = getTickTime();
 
-  if(tick_time < move_time_)
-  {
-    joint_goal_states.position = kinematics_->inverse(&manipulator_, tool_name, getPoseForDrawing(object_, tick_time));
-  }
-  else
+  if(tick_time >= move_time_)
   {
-    joint_goal_states.position = kinematics_->inverse(&manipulator_, tool_name, getPoseForDrawing(object_, move_time_));
+    tick_time = move_time_;
     moving_   = false;
     start_time_ = present_time_;
   }
 
-  return joint_goal_states;
+  via_point_trajectory_->getState(tick_time,
+                                  &joint_goal_states->position,
+                                  &joint_goal_states->velocity,
+                                  &joint_goal_states->acceleration);
+}
+
+void RobotisManipulator::getJointAngleFromStreamingTraj(Goal *joint_goal_states)
+{
+  // The tracker runs on trajectory time as well; it holds while the speed is 0
+  double tick_time = tick_time_;
+  double elapsed = getTickTime() - tick_time;
+  if (elapsed <= 0.0)
+    return;
+
+  if (streaming_trajectory_->update(elapsed,
+                                    &joint_goal_states->position,
+                                    &joint_goal_states->velocity,
+                                    &joint_goal_states->acceleration))
+  {
+    moving_ = false;
+    start_time_ = present_time_;
+  }
 }
 
-void RobotisManipulator::setJointTrajectory(std::vector<double> joint_angle, double move_time)
+bool RobotisManipulator::setJointTrajectory(std::vector<double> joint_angle, double move_time)
 {
+  if (isMotionQueued())
+  {
+    Motion motion = makeMotion(JOINT_TRAJECTORY, 0, move_time);
+    motion.goal_position = joint_angle;
+    return pushMotion(motion);
+  }
+
   trajectory_type_ = JOINT_TRAJECTORY;
 
   Trajectory start;
@@ -901,21 +1812,87 @@ void RobotisManipulator::setJointTrajectory(std::vector<double> joint_angle, dou
     goal_joint_trajectory_.push_back(goal);
   }
 
+  move_time = limitMoveTime(move_time, getFastestMoveTime(joint_angle));
   setMoveTime(move_time);
   makeTrajectory(start_joint_trajectory_, goal_joint_trajectory_);
   startMoving();
+  return true;
 }
 
-void RobotisManipulator::setJointTrajectory(Name tool_name, Pose goal_pose, double move_time)
+bool RobotisManipulator::setJointTrajectory(Name tool_name, Pose goal_pose, double move_time)
 {
+  if (isMotionQueued())
+  {
+    Motion motion = makeMotion(JOINT_TRAJECTORY, tool_name, move_time);
+    motion.goal_pose = goal_pose;
+    motion.use_goal_pose = true;
+    return pushMotion(motion);
+  }
+
   trajectory_type_ = JOINT_TRAJECTORY;
-  std::vector<double> goal_position = kinematics_->inverse(&manipulator_, tool_name, goal_pose);
-  setJointTrajectory(goal_position, move_time);
+  std::vector<double> goal_position;
+  manipulator_.setAllActiveJointAngle(previous_goal_.position);
+  solveInverse(tool_name, goal_pose, &goal_position);
+  return setJointTrajectory(goal_position, move_time);
+}
+
+
+bool RobotisManipulator::setViaPointTrajectory(std::vector<std::vector<double> > via_point, std::vector<double> via_time, double move_time)
+{
+  if (isMotionQueued())
+  {
+    Motion motion = makeMotion(VIA_POINT_TRAJECTORY, 0, move_time);
+    motion.via_point = via_point;
+    motion.via_time = via_time;
+    return pushMotion(motion);
+  }
+
+  Trajectory start;
+
+  start_joint_trajectory_.clear();
+  for (uint8_t index = 0; index < manipulator_.getDOF(); index++)
+  {
+    start.position = previous_goal_.position.at(index);
+    start.velocity = previous_goal_.velocity.at(index);
+    start.acceleration = previous_goal_.acceleration.at(index);
+    start_joint_trajectory_.push_back(start);
+  }
+
+  if (!via_point_trajectory_->init(start_joint_trajectory_, via_point, via_time, move_time))
+    return false;
+
+  trajectory_type_ = VIA_POINT_TRAJECTORY;
+  setMoveTime(via_point_trajectory_->getMoveTime());
+  startMoving();
+  return true;
 }
 
+bool RobotisManipulator::setViaPointTrajectory(Name tool_name, std::vector<Pose> via_pose, std::vector<double> via_time, double move_time)
+{
+  std::vector<std::vector<double> > via_point(via_pose.size());
 
-void RobotisManipulator::setTaskTrajectory(Name tool_name, Pose goal_pose, double move_time)
+  // Each via point seeds the inverse kinematics of the next one
+  manipulator_.setAllActiveJointAngle(previous_goal_.position);
+  for (size_t index = 0; index < via_pose.size(); index++)
+  {
+    solveInverse(tool_name, via_pose.at(index), &via_point[index]);
+    manipulator_.setAllActiveJointAngle(via_point[index]);
+  }
+  manipulator_.setAllActiveJointAngle(previous_goal_.position);
+
+  return setViaPointTrajectory(via_point, via_time, move_time);
+}
+
+bool RobotisManipulator::setTaskTrajectory(Name tool_name, Pose goal_pose, double move_time)
 {
+  if (isMotionQueued())
+  {
+    Motion motion = makeMotion(TASK_TRAJECTORY, tool_name, move_time);
+    motion.goal_pose = goal_pose;
+    return pushMotion(motion);
+  }
+
+  move_time = limitMoveTime(move_time, getFastestMoveTime(tool_name, goal_pose));
   trajectory_type_ = TASK_TRAJECTORY;
   move_time_ = move_time;
 
@@ -924,7 +1901,7 @@ void RobotisManipulator::setTaskTrajectory(Name tool_name, Pose goal_pose, doubl
 
   previous_goal_.pose = manipulator_.getComponentPoseToWorld(tool_name);
 
-  Vector3f goal_position_to_world = goal_pose.position;
+  Vector3r goal_position_to_world = goal_pose.position;
 
   Trajectory start;
   Trajectory goal;
@@ -946,14 +1923,89 @@ void RobotisManipulator::setTaskTrajectory(Name tool_name, Pose goal_pose, doubl
     goal_task_trajectory_.push_back(goal);
   }
 
+  // Orientation follows the geodesic from the present to the goal orientation:
+  // a rotation about one fixed world axis whose angle is the fourth axis
+  task_start_orientation_ = previous_goal_.pose.orientation;
+  Vector3r rotation_vector = task_start_orientation_ *
+                             RM_MATH::matrixLogarithm(task_start_orientation_.transpose() * goal_pose.orientation);
+  Real rotation_angle = rotation_vector.norm();
+  task_rotation_axis_ = (rotation_angle > 0.0) ? Vector3r(rotation_vector / rotation_angle) : Vector3r::Zero();
+
+  start.position = 0.0;
+  start.velocity = 0.0;
+  start.acceleration = 0.0;
+  start_task_trajectory_.push_back(start);
+
+  goal.position = rotation_angle;
+  goal.velocity = 0.0;
+  goal.acceleration = 0.0;
+  goal_task_trajectory_.push_back(goal);
+
   setMoveTime(move_time);
   makeTrajectory(start_task_trajectory_, goal_task_trajectory_);
+
+  if (precompute_task_)
+    makeJointTable(tool_name);
+  else
+    joint_table_.clear();
   startMoving();
+  return true;
+}
 
+void RobotisManipulator::setStreamingTarget(const std::vector<double> &goal_position)
+{
+  if (trajectory_type_ == STREAMING_TRAJECTORY)
+  {
+    // The generator still holds the state it stopped in, so resume only on a new target
+    streaming_trajectory_->setTarget(goal_position);
+    for (uint8_t index = 0; index < manipulator_.getDOF() && !moving_; index++)
+    {
+      if (goal_position.at(index) != previous_goal_.position.at(index))
+        startMoving();
+    }
+    return;
+  }
+
+  Trajectory start;
+  std::vector<double> max_velocity, max_acceleration, max_jerk;
+
+  start_joint_trajectory_.clear();
+  for (uint8_t index = 0; index < manipulator_.getDOF(); index++)
+  {
+    start.position = previous_goal_.position.at(index);
+    start.velocity = previous_goal_.velocity.at(index);
+    start.acceleration = previous_goal_.acceleration.at(index);
+    start_joint_trajectory_.push_back(start);
+  }
+  manipulator_.getAllActiveJointMotionLimit(&max_velocity, &max_acceleration, &max_jerk);
+
+  streaming_trajectory_->init(start_joint_trajectory_);
+  streaming_trajectory_->setLimit(max_velocity, max_acceleration, max_jerk);
+  trajectory_type_ = STREAMING_TRAJECTORY;
+  clearMotionQueue();  // streaming preempts queued motions
+
+  streaming_trajectory_->setTarget(goal_position);
+  startMoving();
+}
+
+void RobotisManipulator::setStreamingTarget(Name tool_name, Pose goal_pose)
+{
+  // Seeded from the previous goal, which follows the target closely while streaming
+  manipulator_.setAllActiveJointAngle(previous_goal_.position);
+  solveInverse(tool_name, goal_pose, &streaming_goal_);
+  setStreamingTarget(streaming_goal_);
 }
 
-void RobotisManipulator::setDrawing(Name tool_name, int object, double move_time, double option)
+bool RobotisManipulator::setDrawing(Name tool_name, int object, double move_time, double option)
 {
+  if (isMotionQueued())
+  {
+    Motion motion = makeMotion(DRAWING, tool_name, move_time);
+    motion.object = object;
+    motion.option = option;
+    return pushMotion(motion);
+  }
+
   trajectory_type_ = DRAWING;
   move_time_ = move_time;
 
@@ -970,11 +2022,26 @@ void RobotisManipulator::setDrawing(Name tool_name, int object, double move_time
   setStartAngularPositionForDrawing(object, 0.0);
 
   object_ = object;
+
+  if (precompute_task_)
+    makeJointTable(tool_name);
+  else
+    joint_table_.clear();
   startMoving();
+  return true;
 }
 
-void RobotisManipulator::setDrawing(Name tool_name, int object, double move_time, Vector3f meter)
+bool RobotisManipulator::setDrawing(Name tool_name, int object, double move_time, Vector3r meter)
 {
+  if (isMotionQueued())
+  {
+    Motion motion = makeMotion(DRAWING, tool_name, move_time);
+    motion.object = object;
+    motion.meter = meter;
+    motion.use_meter = true;
+    return pushMotion(motion);
+  }
+
   trajectory_type_ = DRAWING;
   move_time_ = move_time;
 
@@ -983,10 +2050,10 @@ void RobotisManipulator::setDrawing(Name tool_name, int object, double move_time
 
   previous_goal_.pose = manipulator_.getComponentPoseToWorld(tool_name);
 
-  Vector3f present_position_to_world = previous_goal_.pose.position;
-  Matrix3f present_orientation_to_world = previous_goal_.pose.orientation;
+  Vector3r present_position_to_world = previous_goal_.pose.position;
+  Matrix3r present_orientation_to_world = previous_goal_.pose.orientation;
 
-  Vector3f goal_position_to_world = present_position_to_world + meter;
+  Vector3r goal_position_to_world = present_position_to_world + meter;
 
   Pose start, end;
   start.position = present_position_to_world;
@@ -1003,7 +2070,13 @@ void RobotisManipulator::setDrawing(Name tool_name, int object, double move_time
   drawInit(object, move_time, p_init_arg);
 
   object_ = object;
+
+  if (precompute_task_)
+    makeJointTable(tool_name);
+  else
+    joint_table_.clear();
   startMoving();
+  return true;
 }
 
 
@@ -0,0 +1,486 @@
+﻿/*******************************************************************************
+* Copyright 2016 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM */
+
+#include "robotis_manipulator/robotis_manipulator_drawing.h"
+
+#include <algorithm>
+
+using namespace ROBOTIS_MANIPULATOR;
+
+//-------------------- Drawing primitive --------------------//
+
+DrawingPrimitive::DrawingPrimitive()
+{
+  start_pose_.position = Vector3r::Zero();
+  start_pose_.orientation = Matrix3r::Identity();
+  time_scaling_.init(1.0);
+}
+
+DrawingPrimitive::~DrawingPrimitive() {}
+
+void DrawingPrimitive::setMoveTime(double move_time)
+{
+  time_scaling_.init(move_time);
+}
+
+void DrawingPrimitive::initDraw(const void *arg)
+{
+  const double *get_arg = (const double *)arg;
+  setMoveTime(get_arg[0]);
+}
+
+void DrawingPrimitive::setRadius(double /*radius*/) {}
+
+void DrawingPrimitive::setStartPose(Pose start_pose)
+{
+  start_pose_ = start_pose;
+}
+
+void DrawingPrimitive::setEndPose(Pose /*end_pose*/) {}
+
+void DrawingPrimitive::setAngularStartPosition(double /*start_position*/) {}
+
+Pose DrawingPrimitive::getPose(double tick)
+{
+  Pose pose, pose_vel, pose_acc;
+  getState(tick, &pose, &pose_vel, &pose_acc);
+  return pose;
+}
+
+void DrawingPrimitive::getTimeScaling(double tick, double *s, double *ds, double *dds)
+{
+  time_scaling_.getState(tick, s, ds, dds);
+}
+
+void DrawingPrimitive::getState(double tick, Pose *pose, Pose *pose_vel, Pose *pose_acc)
+{
+  double s, ds, dds;
+  Vector3r position, first_derivative, second_derivative;
+
+  getTimeScaling(tick, &s, &ds, &dds);
+  getPath(s, &position, &first_derivative, &second_derivative);
+
+  // Chain rule: dp/dt = p' ds, d2p/dt2 = p'' ds^2 + p' dds
+  pose->position = start_pose_.position + position;
+  pose->orientation = start_pose_.orientation;
+  pose_vel->position = first_derivative * Real(ds);
+  pose_vel->orientation.setZero();
+  pose_acc->position = second_derivative * Real(ds * ds) + first_derivative * Real(dds);
+  pose_acc->orientation.setZero();
+}
+
+//-------------------- Line --------------------//
+
+Line::Line()
+{
+  displacement_ = Vector3r::Zero();
+}
+
+Line::~Line() {}
+
+void Line::setParam(Vector3r displacement)
+{
+  displacement_ = displacement;
+}
+
+void Line::setEndPose(Pose end_pose)
+{
+  displacement_ = end_pose.position - start_pose_.position;
+}
+
+void Line::getPath(double s, Vector3r *position, Vector3r *first_derivative, Vector3r *second_derivative)
+{
+  *position = displacement_ * Real(s);
+  *first_derivative = displacement_;
+  *second_derivative = Vector3r::Zero();
+}
+
+//-------------------- Ellipse --------------------//
+
+Ellipse::Ellipse()
+{
+  setParam(0.0, 0.0, 1.0, 0.0);
+}
+
+Ellipse::~Ellipse() {}
+
+void Ellipse::setParam(double radius_x, double radius_y, double revolution, double start_angle)
+{
+  radius_x_ = radius_x;
+  radius_y_ = radius_y;
+  radius_growth_ = 0.0;
+  height_ = 0.0;
+  start_angle_ = start_angle;
+  sweep_angle_ = 2.0 * M_PI * revolution;
+}
+
+void Ellipse::getPath(double s, Vector3r *position, Vector3r *first_derivative, Vector3r *second_derivative)
+{
+  // x = rx(s) cos(phi), y = ry(s) sin(phi), z = h s with phi = phi0 + sweep s
+  // and r(s) = r0 + growth s, shifted so that s = 0 is the start position
+  double phi = start_angle_ + sweep_angle_ * s;
+  double cos_phi = cos(phi);
+  double sin_phi = sin(phi);
+  double w = sweep_angle_;
+  double g = radius_growth_;
+  double rx = radius_x_ + g * s;
+  double ry = radius_y_ + g * s;
+
+  *position << rx * cos_phi - radius_x_ * cos(start_angle_),
+               ry * sin_phi - radius_y_ * sin(start_angle_),
+               height_ * s;
+  *first_derivative << g * cos_phi - rx * w * sin_phi,
+                       g * sin_phi + ry * w * cos_phi,
+                       height_;
+  *second_derivative << -2.0 * g * w * sin_phi - rx * w * w * cos_phi,
+                        2.0 * g * w * cos_phi - ry * w * w * sin_phi,
+                        0.0;
+}
+
+//-------------------- Circle, arc, helix, spiral --------------------//
+
+Circle::Circle() {}
+
+Circle::~Circle() {}
+
+void Circle::setParam(double radius, double revolution, double start_angle)
+{
+  Ellipse::setParam(radius, radius, revolution, start_angle);
+}
+
+Arc::Arc() {}
+
+Arc::~Arc() {}
+
+void Arc::setParam(double radius, double start_angle, double sweep_angle)
+{
+  Ellipse::setParam(radius, radius, sweep_angle / (2.0 * M_PI), start_angle);
+}
+
+Helix::Helix() {}
+
+Helix::~Helix() {}
+
+void Helix::setParam(double radius, double pitch, double revolution, double start_angle)
+{
+  Ellipse::setParam(radius, radius, revolution, start_angle);
+  height_ = pitch * revolution;
+}
+
+Spiral::Spiral() {}
+
+Spiral::~Spiral() {}
+
+void Spiral::setParam(double start_radius, double end_radius, double revolution, double start_angle)
+{
+  Ellipse::setParam(start_radius, start_radius, revolution, start_angle);
+  radius_growth_ = end_radius - start_radius;
+}
+
+//-------------------- Curve --------------------//
+
+CurveDrawing::CurveDrawing()
+{
+  resolution_ = 1000;
+  acceleration_time_ = 0.2;
+  origin_ = Vector3r::Zero();
+
+  std::vector<Vector3r> point(2, Vector3r::Zero());
+  setPolyline(point);
+  setMoveTime(1.0);
+}
+
+CurveDrawing::~CurveDrawing() {}
+
+void CurveDrawing::setPolyline(const std::vector<Vector3r> &point)
+{
+  setBSpline(point, 1, std::vector<double>(), std::vector<double>());
+}
+
+bool CurveDrawing::setBezier(const std::vector<Vector3r> &point)
+{
+  if (point.size() < 4 || (point.size() - 1) % 3 != 0)
+    return false;
+
+  // A piecewise cubic Bezier is a cubic B-spline whose inner knots have multiplicity 3
+  uint32_t segment_num = (point.size() - 1) / 3;
+  std::vector<double> knot;
+  knot.push_back(0.0);
+  for (uint32_t segment = 0; segment <= segment_num; segment++)
+    knot.insert(knot.end(), 3, double(segment));
+  knot.push_back(double(segment_num));
+
+  return setBSpline(point, 3, knot, std::vector<double>());
+}
+
+bool CurveDrawing::setBSpline(const std::vector<Vector3r> &control_point,
+                              uint8_t degree,
+                              const std::vector<double> &knot,
+                              const std::vector<double> &weight)
+{
+  uint32_t point_num = control_point.size();
+  if (degree < 1 || degree > CURVE_MAX_DEGREE || point_num < uint32_t(degree) + 1)
+    return false;
+  if (!knot.empty() && knot.size() != point_num + degree + 1)
+    return false;
+  if (!weight.empty() && weight.size() != point_num)
+    return false;
+
+  degree_ = degree;
+  control_point_ = control_point;
+  weight_ = weight;
+
+  if (knot.empty())
+  {
+    // Clamped uniform knots
+    knot_.assign(point_num + degree + 1, 0.0);
+    for (uint32_t index = 0; index < knot_.size(); index++)
+      knot_[index] = std::min(std::max(double(index) - degree, 0.0), double(point_num - degree));
+  }
+  else
+  {
+    knot_ = knot;
+  }
+
+  makeArcLengthTable();
+  return true;
+}
+
+void CurveDrawing::setResolution(uint32_t resolution)
+{
+  resolution_ = std::max(resolution, uint32_t(1));
+}
+
+double CurveDrawing::setFeedRate(double feed_rate, double acceleration_time)
+{
+  if (feed_rate <= 0.0 || acceleration_time < 0.0)
+    return 0.0;
+
+  acceleration_time_ = acceleration_time;
+
+  // The double S profile covers the length at its peak speed in (T - Ta)
+  double move_time = getLength() / feed_rate + acceleration_time;
+  setMoveTime(move_time);
+  return move_time;
+}
+
+double CurveDrawing::getLength()
+{
+  return table_length_.back();
+}
+
+void CurveDrawing::setMoveTime(double move_time)
+{
+  feed_profile_.init(move_time, acceleration_time_, acceleration_time_ / 3.0);
+}
+
+void CurveDrawing::getTimeScaling(double tick, double *s, double *ds, double *dds)
+{
+  feed_profile_.getState(tick, s, ds, dds);
+}
+
+void CurveDrawing::makeArcLengthTable()
+{
+  uint32_t first_span = degree_;
+  uint32_t last_span = control_point_.size() - 1;
+  uint32_t span_num = 0;
+  for (uint32_t span = first_span; span <= last_span; span++)
+  {
+    if (knot_[span + 1] > knot_[span])
+      span_num++;
+  }
+  uint32_t sample_num = std::max(resolution_ / std::max(span_num, uint32_t(1)), uint32_t(1));
+  Vector3r position, first_derivative, second_derivative;
+
+  // Every knot is a table entry, so polyline corners are not cut
+  getCurve(knot_[first_span], &origin_, &first_derivative, &second_derivative);
+  Vector3r previous_position = origin_;
+  table_parameter_.assign(1, knot_[first_span]);
+  table_length_.assign(1, 0.0);
+  for (uint32_t span = first_span; span <= last_span; span++)
+  {
+    double begin = knot_[span];
+    double end = knot_[span + 1];
+    if (end <= begin)
+      continue;
+
+    for (uint32_t sample = 1; sample <= sample_num; sample++)
+    {
+      double u = begin + (end - begin) * sample / sample_num;
+      getCurve(u, &position, &first_derivative, &second_derivative);
+
+      table_parameter_.push_back(u);
+      table_length_.push_back(table_length_.back() + (position - previous_position).norm());
+      previous_position = position;
+    }
+  }
+}
+
+uint32_t CurveDrawing::findSpan(double u)
+{
+  uint32_t last = control_point_.size() - 1;
+  if (u >= knot_[last + 1])
+    return last;
+
+  return std::upper_bound(knot_.begin() + degree_, knot_.begin() + last + 1, u) - knot_.begin() - 1;
+}
+
+void CurveDrawing::getCurve(double u, Vector3r *position, Vector3r *first_derivative, Vector3r *second_derivative)
+{
+  // Basis functions and their derivatives (The NURBS Book, A2.3)
+  const uint8_t p = degree_;
+  uint32_t span = findSpan(u);
+  double ndu[CURVE_MAX_DEGREE + 1][CURVE_MAX_DEGREE + 1];
+  double left[CURVE_MAX_DEGREE + 1], right[CURVE_MAX_DEGREE + 1];
+  double a[2][CURVE_MAX_DEGREE + 1];
+  double ders[3][CURVE_MAX_DEGREE + 1];
+
+  ndu[0][0] = 1.0;
+  for (uint8_t j = 1; j <= p; j++)
+  {
+    left[j] = u - knot_[span + 1 - j];
+    right[j] = knot_[span + j] - u;
+    double saved = 0.0;
+    for (uint8_t r = 0; r < j; r++)
+    {
+      ndu[j][r] = right[r + 1] + left[j - r];
+      double temp = ndu[r][j - 1] / ndu[j][r];
+      ndu[r][j] = saved + right[r + 1] * temp;
+      saved = left[j - r] * temp;
+    }
+    ndu[j][j] = saved;
+  }
+
+  for (uint8_t j = 0; j <= p; j++)
+    ders[0][j] = ndu[j][p];
+
+  for (int r = 0; r <= p; r++)
+  {
+    int s1 = 0, s2 = 1;
+    a[0][0] = 1.0;
+    for (int k = 1; k <= 2; k++)
+    {
+      double d = 0.0;
+      int rk = r - k, pk = p - k;
+      if (k > p)
+      {
+        ders[k][r] = 0.0;
+        continue;
+      }
+      if (r >= k)
+      {
+        a[s2][0] = a[s1][0] / ndu[pk + 1][rk];
+        d = a[s2][0] * ndu[rk][pk];
+      }
+      int j1 = (rk >= -1) ? 1 : -rk;
+      int j2 = (r - 1 <= pk) ? k - 1 : p - r;
+      for (int j = j1; j <= j2; j++)
+      {
+        a[s2][j] = (a[s1][j] - a[s1][j - 1]) / ndu[pk + 1][rk + j];
+        d += a[s2][j] * ndu[rk + j][pk];
+      }
+      if (r <= pk)
+      {
+        a[s2][k] = -a[s1][k - 1] / ndu[pk + 1][r];
+        d += a[s2][k] * ndu[r][pk];
+      }
+      ders[k][r] = d;
+      std::swap(s1, s2);
+    }
+  }
+  for (uint8_t j = 0; j <= p; j++)
+  {
+    ders[1][j] *= p;
+    if (p >= 2)
+      ders[2][j] *= p * (p - 1);
+  }
+
+  // Weighted sums A(u), w(u) and their derivatives
+  Vector3r A[3] = {Vector3r::Zero(), Vector3r::Zero(), Vector3r::Zero()};
+  double w[3] = {0.0, 0.0, 0.0};
+  for (uint8_t j = 0; j <= p; j++)
+  {
+    uint32_t index = span - p + j;
+    double weight = weight_.empty() ? 1.0 : weight_[index];
+    for (uint8_t k = 0; k < 3; k++)
+    {
+      A[k] += control_point_[index] * Real(ders[k][j] * weight);
+      w[k] += ders[k][j] * weight;
+    }
+  }
+
+  // C = A / w, C' = (A' - w' C) / w, C'' = (A'' - 2 w' C' - w'' C) / w
+  *position = A[0] / Real(w[0]);
+  *first_derivative = (A[1] - *position * Real(w[1])) / Real(w[0]);
+  *second_derivative = (A[2] - *first_derivative * Real(2.0 * w[1]) - *position * Real(w[2])) / Real(w[0]);
+}
+
+void CurveDrawing::getPath(double s, Vector3r *position, Vector3r *first_derivative, Vector3r *second_derivative)
+{
+  double length = table_length_.back();
+  double l = std::min(std::max(s, 0.0), 1.0) * length;
+
+  uint32_t index = std::upper_bound(table_length_.begin(), table_length_.end(), l) - table_length_.begin();
+  index = std::min(std::max(index, uint32_t(1)), uint32_t(table_length_.size() - 1));
+
+  double segment = table_length_[index] - table_length_[index - 1];
+  double ratio = (segment > 0.0) ? (l - table_length_[index - 1]) / segment : 0.0;
+  double u = table_parameter_[index - 1] + (table_parameter_[index] - table_parameter_[index - 1]) * ratio;
+
+  Vector3r curve, first, second;
+  getCurve(u, &curve, &first, &second);
+  *position = curve - origin_;
+
+  // Unit speed along the curve: dC/dl = C' / |C'|, d2C/dl2 = C'' / |C'|^2 - C' (C' . C'') / |C'|^4,
+  // scaled by dl/ds = length
+  double speed = first.norm();
+  if (speed <= 0.0)
+  {
+    first_derivative->setZero();
+    second_derivative->setZero();
+    return;
+  }
+  double speed_square = speed * speed;
+  *first_derivative = first * Real(length / speed);
+  *second_derivative = (second / Real(speed_square) - first * Real(first.dot(second) / (speed_square * speed_square))) *
+                       Real(length * length);
+}
+
+//-------------------- Factory --------------------//
+
+DrawingPrimitive *ROBOTIS_MANIPULATOR::makeDrawing(Name drawing_type)
+{
+  switch (drawing_type)
+  {
+  case LINE_DRAWING:
+    return new Line();
+  case CIRCLE_DRAWING:
+    return new Circle();
+  case ARC_DRAWING:
+    return new Arc();
+  case ELLIPSE_DRAWING:
+    return new Ellipse();
+  case HELIX_DRAWING:
+    return new Helix();
+  case SPIRAL_DRAWING:
+    return new Spiral();
+  case CURVE_DRAWING:
+    return new CurveDrawing();
+  }
+  return NULL;
+}
@@ -0,0 +1,235 @@
+﻿/*******************************************************************************
+* Copyright 2016 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM */
+
+#include "robotis_manipulator/robotis_manipulator_executor.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace ROBOTIS_MANIPULATOR;
+
+static double toSecond(const struct timespec &time)
+{
+  return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+static void addNanosecond(struct timespec *time, int64_t nanosecond)
+{
+  time->tv_nsec += nanosecond;
+  while (time->tv_nsec >= 1000000000)
+  {
+    time->tv_nsec -= 1000000000;
+    time->tv_sec++;
+  }
+}
+
+ControlExecutor::ControlExecutor(RobotisManipulator *manipulator) : manipulator_(manipulator),
+                                                                   tool_name_(0),
+                                                                   actuator_name_(0),
+                                                                   running_(false),
+                                                                   memory_locked_(false),
+                                                                   present_time_(0.0)
+{
+  // Priority inheritance keeps a low priority planner holding the lock from
+  // being preempted while the tick waits for it
+  pthread_mutexattr_t attribute;
+  pthread_mutexattr_init(&attribute);
+#ifdef _POSIX_THREAD_PRIO_INHERIT
+  pthread_mutexattr_setprotocol(&attribute, PTHREAD_PRIO_INHERIT);
+#endif
+  pthread_mutex_init(&mutex_, &attribute);
+  pthread_mutexattr_destroy(&attribute);
+
+  option_.priority = 0;
+  option_.cpu = -1;
+  option_.lock_memory = false;
+  stat_.realtime = false;
+  stat_.pinned = false;
+  stat_.memory_locked = false;
+  resetStat();
+}
+
+ControlExecutor::~ControlExecutor()
+{
+  stop();
+  pthread_mutex_destroy(&mutex_);
+}
+
+void ControlExecutor::setOption(ExecutorOption option)
+{
+  option_ = option;
+}
+
+ExecutorOption ControlExecutor::getOption()
+{
+  return option_;
+}
+
+bool ControlExecutor::start(Name tool_name, Name actuator_name)
+{
+  if (running_)
+    return false;
+  if (manipulator_->getControlTime() <= 0.0)
+    return false;  //error
+
+  tool_name_ = tool_name;
+  actuator_name_ = actuator_name;
+  resetStat();
+  stat_.realtime = false;
+  stat_.pinned = false;
+
+  if (option_.lock_memory && !memory_locked_)
+    memory_locked_ = (mlockall(MCL_CURRENT | MCL_FUTURE) == 0);
+  stat_.memory_locked = memory_locked_;
+
+  // The thread applies its own priority and affinity before the first tick
+  running_ = true;
+  thread_ = std::thread(&ControlExecutor::run, this);
+  return true;
+}
+
+void ControlExecutor::stop()
+{
+  running_ = false;
+  if (thread_.joinable())
+    thread_.join();
+
+  if (memory_locked_)
+  {
+    munlockall();
+    memory_locked_ = false;
+  }
+}
+
+bool ControlExecutor::isRunning()
+{
+  return running_;
+}
+
+void ControlExecutor::lock()
+{
+  pthread_mutex_lock(&mutex_);
+}
+
+void ControlExecutor::unlock()
+{
+  pthread_mutex_unlock(&mutex_);
+}
+
+ExecutorStat ControlExecutor::getStat()
+{
+  lock();
+  ExecutorStat stat = stat_;
+  unlock();
+  return stat;
+}
+
+void ControlExecutor::resetStat()
+{
+  lock();
+  stat_.tick = 0;
+  stat_.overrun = 0;
+  stat_.max_latency = 0.0;
+  stat_.max_execution_time = 0.0;
+  stat_.sleep_error = 0;
+  unlock();
+}
+
+void ControlExecutor::run()
+{
+  // Without the privileges the thread keeps running with default settings
+  bool realtime = false;
+  bool pinned = false;
+  if (option_.priority > 0)
+  {
+    struct sched_param param;
+    param.sched_priority = option_.priority;
+    realtime = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+  }
+#ifdef __linux__
+  if (option_.cpu >= 0)
+  {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(option_.cpu, &cpu_set);
+    pinned = (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0);
+  }
+#endif
+  lock();
+  stat_.realtime = realtime;
+  stat_.pinned = pinned;
+  unlock();
+
+  int64_t period = int64_t(manipulator_->getControlTime() * 1e9 + 0.5);
+  struct timespec start_time, deadline, now;
+
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+  deadline = start_time;
+  double time_offset = present_time_;
+
+  while (running_)
+  {
+    addNanosecond(&deadline, period);
+    // Interrupted by a signal: sleep again to the same deadline
+    int error;
+    do
+    {
+      error = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+    } while (error == EINTR);
+    if (error != 0)
+    {
+      //error
+      lock();
+      stat_.sleep_error = error;
+      unlock();
+      running_ = false;
+      break;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double latency = toSecond(now) - toSecond(deadline);
+
+    lock();
+    // The present time is the deadline, so trajectories see an exact period
+    present_time_ = time_offset + toSecond(deadline) - toSecond(start_time);
+    manipulator_->controlLoop(present_time_, tool_name_, actuator_name_);
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double execution_time = toSecond(end) - toSecond(now);
+
+    stat_.tick++;
+    stat_.max_latency = std::max(stat_.max_latency, latency);
+    stat_.max_execution_time = std::max(stat_.max_execution_time, execution_time);
+
+    // Skip the deadlines that already passed
+    struct timespec next = deadline;
+    addNanosecond(&next, period);
+    if (toSecond(end) > toSecond(next))
+    {
+      stat_.overrun++;
+      int64_t missed = int64_t((toSecond(end) - toSecond(next)) * 1e9) / period + 1;
+      addNanosecond(&deadline, missed * period);
+    }
+    unlock();
+  }
+}
@@ -0,0 +1,188 @@
+﻿/*******************************************************************************
+* Copyright 2016 ROBOTIS CO., LTD.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*     http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*******************************************************************************/
+
+/* Authors: Darby Lim, Hye-Jong KIM */
+
+#include "robotis_manipulator/robotis_manipulator_kinematics.h"
+
+using namespace ROBOTIS_MANIPULATOR;
+using namespace Eigen;
+
+DampedLeastSquares::DampedLeastSquares()
+{
+  option_.max_iteration = 10;
+  option_.tolerance = 1e-4;
+  option_.damping = 1e-2;
+  option_.min_damping = 1e-4;
+  option_.max_damping = 1.0;
+
+  result_.converged = false;
+  result_.iteration = 0;
+  result_.residual = 0.0;
+}
+
+DampedLeastSquares::~DampedLeastSquares() {}
+
+void DampedLeastSquares::setOption(InverseOption option)
+{
+  option_ = option;
+}
+
+InverseOption DampedLeastSquares::getOption()
+{
+  return option_;
+}
+
+InverseResult DampedLeastSquares::getResult()
+{
+  return result_;
+}
+
+Real DampedLeastSquares::getPoseError(Manipulator *manipulator, Name tool_name, const Pose &target_pose, Vector6r *pose_error)
+{
+  RM_MATH::poseDifference(target_pose.position, manipulator->getComponentPositionToWorld(tool_name),
+                          target_pose.orientation, manipulator->getComponentOrientationToWorld(tool_name),
+                          pose_error);
+  return pose_error->norm();
+}
+
+bool DampedLeastSquares::solve(Manipulator *manipulator, Name tool_name, Pose target_pose, std::vector<double> *goal_angle)
+{
+  // Warm start from the joint angles already set in the manipulator
+  manipulator->getAllActiveJointAngle(goal_angle);
+  manipulator->getAllActiveJointAngleLimit(&min_angle_, &max_angle_);
+
+  uint8_t dof = goal_angle->size();
+  Real damping = option_.damping;
+
+  trial_angle_.resize(dof);
+  manipulator->jacobian(tool_name, &jacobian_);
+  result_.residual = getPoseError(manipulator, tool_name, target_pose, &pose_error_);
+  result_.converged = false;
+  result_.iteration = 0;
+
+  while (result_.residual >= option_.tolerance && result_.iteration < option_.max_iteration)
+  {
+    result_.iteration++;
+
+    // delta = (J^T J + lambda^2 I)^-1 J^T e
+    normal_matrix_.noalias() = jacobian_.transpose() * jacobian_;
+    normal_matrix_.diagonal().array() += damping * damping;
+    gradient_.noalias() = jacobian_.transpose() * pose_error_;
+    decomposition_.compute(normal_matrix_);
+    delta_ = decomposition_.solve(gradient_);
+
+    for (uint8_t index = 0; index < dof; index++)
+    {
+      double angle = (*goal_angle)[index] + delta_(index);
+      trial_angle_[index] = std::min(std::max(angle, min_angle_[index]), max_angle_[index]);
+    }
+
+    manipulator->setAllActiveJointAngle(trial_angle_);
+    manipulator->forwardKinematics();
+    Real trial_residual = getPoseError(manipulator, tool_name, target_pose, &trial_error_);
+
+    // Levenberg-Marquardt: take a step only if it lowers the error and relax the
+    // damping, otherwise stay put and retry with a stiffer one.
+    if (trial_residual < result_.residual)
+    {
+      goal_angle->swap(trial_angle_);
+      pose_error_ = trial_error_;
+      result_.residual = trial_residual;
+      manipulator->jacobian(tool_name, &jacobian_);
+      damping = std::max(damping * Real(0.5), option_.min_damping);
+    }
+    else
+    {
+      manipulator->setAllActiveJointAngle(*goal_angle);
+      damping = std::min(damping * Real(4.0), option_.max_damping);
+    }
+  }
+
+  manipulator->forwardKinematics();
+  result_.converged = (result_.residual < option_.tolerance);
+  return result_.converged;
+}
+
+uint32_t DampedLeastSquares::solve(const Manipulator &manipulator,
+                                   Name tool_name,
+                                   const std::vector<Pose> &target_pose,
+                                   std::vector<std::vector<double> > *goal_angle,
+                                   std::vector<InverseResult> *result,
+                                   bool seed_from_previous,
+                                   uint8_t thread_num)
+{
+  uint32_t size = target_pose.size();
+  goal_angle->resize(size);
+  result->resize(size);
+
+  // Count workers in 32 bits so a large hardware_concurrency() does not wrap
+  uint32_t worker_num = thread_num;
+  if (worker_num == 0)
+    worker_num = std::max(std::thread::hardware_concurrency(), 1u);
+  if (worker_num > size)
+    worker_num = std::max(size, uint32_t(1));
+
+  // Contiguous ranges keep consecutive targets, and so the warm start, on one worker
+  std::vector<Manipulator> manipulator_copy(worker_num, manipulator);
+  std::vector<DampedLeastSquares> solver_copy(worker_num, *this);
+  std::vector<std::thread> worker;
+  worker.reserve(worker_num);
+
+  for (uint32_t index = 0; index < worker_num; index++)
+  {
+    uint32_t begin = uint32_t(uint64_t(size) * index / worker_num);
+    uint32_t end = uint32_t(uint64_t(size) * (index + 1) / worker_num);
+
+    worker.push_back(std::thread(&DampedLeastSquares::solveRange, &solver_copy[index],
+                                 &manipulator_copy[index], tool_name, &target_pose,
+                                 goal_angle, result, seed_from_previous, begin, end));
+  }
+
+  for (uint32_t index = 0; index < worker_num; index++)
+    worker[index].join();
+
+  uint32_t converged = 0;
+  for (uint32_t index = 0; index < size; index++)
+  {
+    if ((*result)[index].converged)
+      converged++;
+  }
+  return converged;
+}
+
+void DampedLeastSquares::solveRange(Manipulator *manipulator,
+                                    Name tool_name,
+                                    const std::vector<Pose> *target_pose,
+                                    std::vector<std::vector<double> > *goal_angle,
+                                    std::vector<InverseResult> *result,
+                                    bool seed_from_previous,
+                                    uint32_t begin,
+                                    uint32_t end)
+{
+  std::vector<double> seed;
+  manipulator->getAllActiveJointAngle(&seed);
+
+  for (uint32_t index = begin; index < end; index++)
+  {
+    solve(manipulator, tool_name, (*target_pose)[index], &(*goal_angle)[index]);
+    (*result)[index] = result_;
+
+    // solve() leaves the manipulator at its answer; only keep it as the next seed if it converged
+    if (!seed_from_previous || !result_.converged)
+      manipulator->setAllActiveJointAngle(seed);
+  }
+}
@@ -29,29 +29,31 @@ using namespace Eigen;
 ///////////////////////////*initialize function*/////////////////////////////
 void Manipulator::addWorld(Name world_name,
                            Name child_name,
-                           Vector3f world_position,
-                           Matrix3f world_orientation)
+                           Vector3r world_position,
+                           Matrix3r world_orientation)
 {
   world_.name = world_name;
   world_.child = child_name;
   world_.pose.position = world_position;
   world_.pose.orientation = world_orientation;
-  world_.origin.velocity = VectorXf::Zero(3);
-  world_.origin.acceleration = VectorXf::Zero(3);
+  world_.origin.velocity = VectorXr::Zero(3);
+  world_.origin.acceleration = VectorXr::Zero(3);
 }
 
 void Manipulator::addComponent(Name my_name,
                                Name parent_name,
                                Name child_name,
-                               Vector3f relative_position,
-                               Matrix3f relative_orientation,
-                               Vector3f axis_of_rotation,
+                               Vector3r relative_position,
+                               Matrix3r relative_orientation,
+                               Vector3r axis_of_rotation,
                                int8_t joint_actuator_id,
                                double coefficient,
                                double mass,
-                               Matrix3f inertia_tensor,
-                               Vector3f center_of_mass)
+                               Matrix3r inertia_tensor,
+                               Vector3r center_of_mass)
 {
+  releaseComponent();
+
   if (joint_actuator_id != -1)
     dof_++;
 
@@ -61,16 +63,21 @@ void Manipulator::addComponent(Name my_name,
   temp_component.child.push_back(child_name);
   temp_component.relative_to_parent.position = relative_position;
   temp_component.relative_to_parent.orientation = relative_orientation;
-  temp_component.pose_to_world.position = Vector3f::Zero();
-  temp_component.pose_to_world.orientation = Matrix3f::Identity(3, 3);
-  temp_component.origin.velocity = VectorXf::Zero(3);
-  temp_component.origin.acceleration = VectorXf::Zero(3);
+  temp_component.pose_to_world.position = Vector3r::Zero();
+  temp_component.pose_to_world.orientation = Matrix3r::Identity(3, 3);
+  temp_component.origin.velocity = VectorXr::Zero(3);
+  temp_component.origin.acceleration = VectorXr::Zero(3);
   temp_component.joint.id = joint_actuator_id;
   temp_component.joint.coefficient = coefficient;
   temp_component.joint.axis = axis_of_rotation;
   temp_component.joint.angle = 0.0;
   temp_component.joint.velocity = 0.0;
   temp_component.joint.acceleration = 0.0;
+  temp_component.joint.min_angle = -DBL_MAX;
+  temp_component.joint.max_angle = DBL_MAX;
+  temp_component.joint.max_velocity = DBL_MAX;
+  temp_component.joint.max_acceleration = DBL_MAX;
+  temp_component.joint.max_jerk = DBL_MAX;
   temp_component.tool.id = -1;
   temp_component.tool.coefficient = 0;
   temp_component.tool.on_off = false;
@@ -89,29 +96,36 @@ void Manipulator::addComponentChild(Name my_name, Name child_name)
 
 void Manipulator::addTool(Name my_name,
                           Name parent_name,
-                          Vector3f relative_position,
-                          Matrix3f relative_orientation,
+                          Vector3r relative_position,
+                          Matrix3r relative_orientation,
                           int8_t tool_id,
                           double coefficient,
                           double mass,
-                          Matrix3f inertia_tensor,
-                          Vector3f center_of_mass)
+                          Matrix3r inertia_tensor,
+                          Vector3r center_of_mass)
 {
+  releaseComponent();
+
   Component temp_component;
 
   temp_component.parent = parent_name;
   temp_component.relative_to_parent.position = relative_position;
   temp_component.relative_to_parent.orientation = relative_orientation;
-  temp_component.pose_to_world.position = Vector3f::Zero();
-  temp_component.pose_to_world.orientation = Matrix3f::Identity(3, 3);
-  temp_component.origin.velocity = VectorXf::Zero(3);
-  temp_component.origin.acceleration = VectorXf::Zero(3);
+  temp_component.pose_to_world.position = Vector3r::Zero();
+  temp_component.pose_to_world.orientation = Matrix3r::Identity(3, 3);
+  temp_component.origin.velocity = VectorXr::Zero(3);
+  temp_component.origin.acceleration = VectorXr::Zero(3);
   temp_component.joint.id = -1;
   temp_component.joint.coefficient = 0;
-  temp_component.joint.axis = Vector3f::Zero();
+  temp_component.joint.axis = Vector3r::Zero();
   temp_component.joint.angle = 0.0;
   temp_component.joint.velocity = 0.0;
   temp_component.joint.acceleration = 0.0;
+  temp_component.joint.min_angle = -DBL_MAX;
+  temp_component.joint.max_angle = DBL_MAX;
+  temp_component.joint.max_velocity = DBL_MAX;
+  temp_component.joint.max_acceleration = DBL_MAX;
+  temp_component.joint.max_jerk = DBL_MAX;
   temp_component.tool.id = tool_id;
   temp_component.tool.coefficient = coefficient;
   temp_component.tool.on_off = false;
@@ -125,7 +139,146 @@ void Manipulator::addTool(Name my_name,
 
 void Manipulator::checkManipulatorSetting()
 {
+  compileComponent();
+}
+
+void Manipulator::compileComponent()
+{
+  std::map<Name, Component>::iterator it;
+  int16_t index = 0;
+
+  for (uint16_t num = 0; num < 256; num++)
+  {
+    index_[num] = -1;
+    active_joint_by_id_[num] = -1;
+  }
+
+  index_name_.clear();
+  parent_index_.clear();
+  joint_id_.clear();
+  tool_id_.clear();
+  joint_axis_.clear();
+  joint_coefficient_.clear();
+  joint_angle_.clear();
+  joint_velocity_.clear();
+  joint_acceleration_.clear();
+  joint_min_angle_.clear();
+  joint_max_angle_.clear();
+  relative_position_.clear();
+  relative_orientation_.clear();
+  position_to_world_.clear();
+  orientation_to_world_.clear();
+  joint_axis_to_world_.clear();
+  active_joint_index_.clear();
+  active_joint_coefficient_.clear();
+  active_joint_receive_order_.clear();
+  forward_order_.clear();
+  compiled_ = false;
+
+  // The dense loops count components with uint8_t
+  if (component_.size() > MAX_COMPONENT_NUM)
+  {
+    //error
+    return;
+  }
+
+  for (it = component_.begin(); it != component_.end(); it++, index++)
+  {
+    index_[(uint8_t)it->first] = index;
+    index_name_.push_back(it->first);
+    joint_id_.push_back(it->second.joint.id);
+    tool_id_.push_back(it->second.tool.id);
+    joint_axis_.push_back(it->second.joint.axis);
+    joint_coefficient_.push_back(it->second.joint.coefficient);
+    joint_angle_.push_back(it->second.joint.angle);
+    joint_velocity_.push_back(it->second.joint.velocity);
+    joint_acceleration_.push_back(it->second.joint.acceleration);
+    joint_min_angle_.push_back(it->second.joint.min_angle);
+    joint_max_angle_.push_back(it->second.joint.max_angle);
+    relative_position_.push_back(it->second.relative_to_parent.position);
+    relative_orientation_.push_back(it->second.relative_to_parent.orientation);
+    position_to_world_.push_back(it->second.pose_to_world.position);
+    orientation_to_world_.push_back(it->second.pose_to_world.orientation);
+    joint_axis_to_world_.push_back(it->second.pose_to_world.orientation * it->second.joint.axis);
+
+    if (it->second.joint.id != -1)
+    {
+      active_joint_by_id_[(uint8_t)it->second.joint.id] = active_joint_index_.size();
+      active_joint_index_.push_back(index);
+      active_joint_coefficient_.push_back(it->second.joint.coefficient);
+    }
+  }
 
+  // Actuators report angles sorted by ID; store where each active joint's
+  // angle lands in that reply.
+  for (uint8_t active = 0; active < active_joint_index_.size(); active++)
+  {
+    int8_t id = joint_id_[active_joint_index_[active]];
+    uint8_t rank = 0;
+
+    for (uint8_t other = 0; other < active_joint_index_.size(); other++)
+    {
+      int8_t other_id = joint_id_[active_joint_index_[other]];
+      if ((uint8_t)other_id < (uint8_t)id || (other_id == id && other < active))
+        rank++;
+    }
+    active_joint_receive_order_.push_back(rank);
+  }
+
+  for (it = component_.begin(); it != component_.end(); it++)
+    parent_index_.push_back(index_[(uint8_t)it->second.parent]);
+
+  // Depth-first preorder: every parent precedes its children and each
+  // subtree occupies [forward_order_position_, subtree_end_).
+  forward_order_position_.assign(index_name_.size(), -1);
+  subtree_end_.assign(index_name_.size(), -1);
+  pose_dirty_.assign(index_name_.size(), true);
+  has_dirty_pose_ = true;
+  for (index = 0; index < (int16_t)index_name_.size(); index++)
+  {
+    if (parent_index_[index] == -1)
+      addForwardOrder(index);
+  }
+
+  compiled_ = true;
+}
+
+void Manipulator::addForwardOrder(int16_t index)
+{
+  forward_order_position_[index] = forward_order_.size();
+  forward_order_.push_back(index);
+
+  for (int16_t child = 0; child < (int16_t)parent_index_.size(); child++)
+  {
+    if (parent_index_[child] == index && child != index)
+      addForwardOrder(child);
+  }
+  subtree_end_[index] = forward_order_.size();
+}
+
+void Manipulator::syncComponent()
+{
+  if (!compiled_)
+    return;
+
+  updateLazyPose();
+
+  for (uint8_t index = 0; index < index_name_.size(); index++)
+  {
+    Component &component = component_.at(index_name_[index]);
+
+    component.joint.angle = joint_angle_[index];
+    component.joint.velocity = joint_velocity_[index];
+    component.joint.acceleration = joint_acceleration_[index];
+    component.pose_to_world.position = position_to_world_[index];
+    component.pose_to_world.orientation = orientation_to_world_[index];
+  }
+}
+
+void Manipulator::releaseComponent()
+{
+  syncComponent();
+  compiled_ = false;
 }
 /////////////////////////////////////////////////////////////////////////////
 
@@ -133,16 +286,19 @@ void Manipulator::checkManipulatorSetting()
 void Manipulator::setWorldPose(Pose world_pose)
 {
   world_.pose = world_pose;
+  setWorldDirty();
 }
 
-void Manipulator::setWorldPosition(Vector3f world_position)
+void Manipulator::setWorldPosition(Vector3r world_position)
 {
   world_.pose.position = world_position;
+  setWorldDirty();
 }
 
-void Manipulator::setWorldOrientation(Matrix3f world_orientation)
+void Manipulator::setWorldOrientation(Matrix3r world_orientation)
 {
   world_.pose.orientation = world_orientation;
+  setWorldDirty();
 }
 
 void Manipulator::setWorldState(State world_state)
@@ -150,12 +306,12 @@ void Manipulator::setWorldState(State world_state)
   world_.origin = world_state;
 }
 
-void Manipulator::setWorldVelocity(VectorXf world_velocity)
+void Manipulator::setWorldVelocity(VectorXr world_velocity)
 {
   world_.origin.velocity = world_velocity;
 }
 
-void Manipulator::setWorldAcceleration(VectorXf world_acceleration)
+void Manipulator::setWorldAcceleration(VectorXr world_acceleration)
 {
   world_.origin.acceleration = world_acceleration;
 }
@@ -164,20 +320,28 @@ void Manipulator::setComponent(Name name, Component component, bool *error)
 {
   if (component_.find(name) != component_.end())
   {
-    component_.insert(std::make_pair(name, component));
-    *error = false;
+    releaseComponent();
+    component_.at(name) = component;
+    if (error != NULL)
+      *error = false;
   }
   else
   {
-    *error = true;
+    if (error != NULL)
+      *error = true;
   }
 }
 
 void Manipulator::setComponentPoseToWorld(Name name, Pose pose_to_world)
 {
-  if (component_.find(name) != component_.end())
+  int16_t index = getComponentIndex(name);
+
+  if (index != -1)
   {
-    component_.at(name).pose_to_world = pose_to_world;
+    position_to_world_[index] = pose_to_world.position;
+    orientation_to_world_[index] = pose_to_world.orientation;
+    joint_axis_to_world_[index] = pose_to_world.orientation * joint_axis_[index];
+    setPoseClean(index);
   }
   else
   {
@@ -185,11 +349,14 @@ void Manipulator::setComponentPoseToWorld(Name name, Pose pose_to_world)
   }
 }
 
-void Manipulator::setComponentPositionToWorld(Name name, Vector3f position_to_world)
+void Manipulator::setComponentPositionToWorld(Name name, Vector3r position_to_world)
 {
-  if (component_.find(name) != component_.end())
+  int16_t index = getComponentIndex(name);
+
+  if (index != -1)
   {
-    component_.at(name).pose_to_world.position = position_to_world;
+    position_to_world_[index] = position_to_world;
+    setPoseClean(index);
   }
   else
   {
@@ -197,11 +364,15 @@ void Manipulator::setComponentPositionToWorld(Name name, Vector3f position_to_wo
   }
 }
 
-void Manipulator::setComponentOrientationToWorld(Name name, Matrix3f orientation_to_wolrd)
+void Manipulator::setComponentOrientationToWorld(Name name, Matrix3r orientation_to_wolrd)
 {
-  if (component_.find(name) != component_.end())
+  int16_t index = getComponentIndex(name);
+
+  if (index != -1)
   {
-    component_.at(name).pose_to_world.orientation = orientation_to_wolrd;
+    orientation_to_world_[index] = orientation_to_wolrd;
+    joint_axis_to_world_[index] = orientation_to_wolrd * joint_axis_[index];
+    setPoseClean(index);
   }
   else
   {
@@ -221,7 +392,7 @@ void Manipulator::setComponentStateToWorld(Name name, State state_to_world)
   }
 }
 
-void Manipulator::setComponentVelocityToWorld(Name name, VectorXf velocity)
+void Manipulator::setComponentVelocityToWorld(Name name, VectorXr velocity)
 {
   if (velocity.size() != 6)
   {
@@ -240,7 +411,7 @@ void Manipulator::setComponentVelocityToWorld(Name name, VectorXf velocity)
   }
 }
 
-void Manipulator::setComponentAccelerationToWorld(Name name, VectorXf acceleration)
+void Manipulator::setComponentAccelerationToWorld(Name name, VectorXr acceleration)
 {
   if (acceleration.size() != 6)
   {
@@ -261,59 +432,78 @@ void Manipulator::setComponentAccelerationToWorld(Name name, VectorXf accelerati
 
 void Manipulator::setComponentJointAngle(Name name, double angle)
 {
-  if (component_.at(name).tool.id > 0)
+  int16_t index = getComponentIndex(name);
+
+  if (index == -1 || tool_id_[index] > 0)
   {
     //error
   }
-  else
+  else if (joint_angle_[index] != angle)
   {
-    if (component_.find(name) != component_.end())
-    {
-      component_.at(name).joint.angle = angle;
-    }
-    else
-    {
-      //error
-    }
+    joint_angle_[index] = angle;
+    setPoseDirty(index);
   }
 }
 
 void Manipulator::setComponentJointVelocity(Name name, double angular_velocity)
 {
-  if (component_.at(name).tool.id > 0)
+  int16_t index = getComponentIndex(name);
+
+  if (index == -1 || tool_id_[index] > 0)
   {
     //error
   }
   else
   {
-    if (component_.find(name) != component_.end())
-    {
-      component_.at(name).joint.velocity = angular_velocity;
-    }
-    else
-    {
-      //error
-    }
+    joint_velocity_[index] = angular_velocity;
   }
 }
 
 void Manipulator::setComponentJointAcceleration(Name name, double angular_acceleration)
 {
-  if (component_.at(name).tool.id > 0)
+  int16_t index = getComponentIndex(name);
+
+  if (index == -1 || tool_id_[index] > 0)
   {
     //error
   }
   else
   {
-    if (component_.find(name) != component_.end())
-    {
-      component_.at(name).joint.acceleration = angular_acceleration;
-    }
-    else
+    joint_acceleration_[index] = angular_acceleration;
+  }
+}
+
+void Manipulator::setComponentJointMotionLimit(Name name, double max_velocity, double max_acceleration, double max_jerk)
+{
+  if (component_.find(name) != component_.end())
+  {
+    component_.at(name).joint.max_velocity = max_velocity;
+    component_.at(name).joint.max_acceleration = max_acceleration;
+    component_.at(name).joint.max_jerk = max_jerk;
+  }
+  else
+  {
+    //error
+  }
+}
+
+void Manipulator::setComponentJointAngleLimit(Name name, double min_angle, double max_angle)
+{
+  if (component_.find(name) != component_.end())
+  {
+    component_.at(name).joint.min_angle = min_angle;
+    component_.at(name).joint.max_angle = max_angle;
+
+    if (compiled_)
     {
-      //error
+      joint_min_angle_[index_[(uint8_t)name]] = min_angle;
+      joint_max_angle_[index_[(uint8_t)name]] = max_angle;
     }
   }
+  else
+  {
+    //error
+  }
 }
 
 void Manipulator::setComponentToolOnOff(Name name, bool on_off)
@@ -354,17 +544,19 @@ void Manipulator::setComponentToolValue(Name name, double value)
   }
 }
 
-void Manipulator::setAllActiveJointAngle(std::vector<double> angle_vector)
+void Manipulator::setAllActiveJointAngle(const std::vector<double> &angle_vector)
 {
-  std::map<Name, Component>::iterator it;
-  int8_t index = 0;
+  if (!compiled_)
+    compileComponent();
 
-  for (it = component_.begin(); it != component_.end(); it++)
+  for (uint8_t index = 0; index < active_joint_index_.size(); index++)
   {
-    if (component_.at(it->first).joint.id != -1)
+    int16_t joint = active_joint_index_[index];
+
+    if (joint_angle_[joint] != angle_vector.at(index))
     {
-      component_.at(it->first).joint.angle = angle_vector.at(index);
-      index++;
+      joint_angle_[joint] = angle_vector.at(index);
+      setPoseDirty(joint);
     }
   }
 }
@@ -396,12 +588,12 @@ Pose Manipulator::getWorldPose()
   return world_.pose;
 }
 
-Vector3f Manipulator::getWorldPosition()
+Vector3r Manipulator::getWorldPosition()
 {
   return world_.pose.position;
 }
 
-Matrix3f Manipulator::getWorldOrientation()
+Matrix3r Manipulator::getWorldOrientation()
 {
   return world_.pose.orientation;
 }
@@ -411,23 +603,25 @@ State Manipulator::getWorldState()
   return world_.origin;
 }
 
-VectorXf Manipulator::getWorldVelocity()
+VectorXr Manipulator::getWorldVelocity()
 {
   return world_.origin.velocity;
 }
 
-VectorXf Manipulator::getWorldAcceleration()
+VectorXr Manipulator::getWorldAcceleration()
 {
   return world_.origin.acceleration;
 }
 
 std::map<Name, Component> Manipulator::getAllComponent()
 {
+  syncComponent();
   return component_;
 }
 
 std::map<Name, Component>::iterator Manipulator::getIteratorBegin()
 {
+  syncComponent();
   return component_.begin();
 }
 
@@ -438,6 +632,7 @@ std::map<Name, Component>::iterator Manipulator::getIteratorEnd()
 
 Component Manipulator::getComponent(Name name)
 {
+  syncComponent();
   return component_.at(name);
 }
 
@@ -453,17 +648,30 @@ std::vector<Name> Manipulator::getComponentChildName(Name name)
 
 Pose Manipulator::getComponentPoseToWorld(Name name)
 {
-  return component_.at(name).pose_to_world;
+  int16_t index = getComponentIndex(name);
+  Pose pose_to_world;
+
+  updateLazyPose();
+
+  pose_to_world.position = position_to_world_.at(index);
+  pose_to_world.orientation = orientation_to_world_.at(index);
+  return pose_to_world;
 }
 
-Vector3f Manipulator::getComponentPositionToWorld(Name name)
+Vector3r Manipulator::getComponentPositionToWorld(Name name)
 {
-  return component_.at(name).pose_to_world.position;
+  int16_t index = getComponentIndex(name);
+
+  updateLazyPose();
+  return position_to_world_.at(index);
 }
 
-Matrix3f Manipulator::getComponentOrientationToWorld(Name name)
+Matrix3r Manipulator::getComponentOrientationToWorld(Name name)
 {
-  return component_.at(name).pose_to_world.orientation;
+  int16_t index = getComponentIndex(name);
+
+  updateLazyPose();
+  return orientation_to_world_.at(index);
 }
 
 State Manipulator::getComponentStateToWorld(Name name)
@@ -471,12 +679,12 @@ State Manipulator::getComponentStateToWorld(Name name)
   return component_.at(name).origin;
 }
 
-VectorXf Manipulator::getComponentVelocityToWorld(Name name)
+VectorXr Manipulator::getComponentVelocityToWorld(Name name)
 {
   return component_.at(name).origin.velocity;
 }
 
-VectorXf Manipulator::getComponentAccelerationToWorld(Name name)
+VectorXr Manipulator::getComponentAccelerationToWorld(Name name)
 {
   return component_.at(name).origin.acceleration;
 }
@@ -486,49 +694,50 @@ Pose Manipulator::getComponentRelativePoseToParent(Name name)
   return component_.at(name).relative_to_parent;
 }
 
-Vector3f Manipulator::getComponentRelativePositionToParent(Name name)
+Vector3r Manipulator::getComponentRelativePositionToParent(Name name)
 {
-  return component_.at(name).relative_to_parent.position;
+  return relative_position_.at(getComponentIndex(name));
 }
 
-Matrix3f Manipulator::getComponentRelativeOrientationToParent(Name name)
+Matrix3r Manipulator::getComponentRelativeOrientationToParent(Name name)
 {
-  return component_.at(name).relative_to_parent.orientation;
+  return relative_orientation_.at(getComponentIndex(name));
 }
 
 Joint Manipulator::getComponentJoint(Name name)
 {
+  syncComponent();
   return component_.at(name).joint;
 }
 
 int8_t Manipulator::getComponentJointId(Name name)
 {
-  return component_.at(name).joint.id;
+  return joint_id_.at(getComponentIndex(name));
 }
 
 double Manipulator::getComponentJointCoefficient(Name name)
 {
-  return component_.at(name).joint.coefficient;
+  return joint_coefficient_.at(getComponentIndex(name));
 }
 
-Vector3f Manipulator::getComponentJointAxis(Name name)
+Vector3r Manipulator::getComponentJointAxis(Name name)
 {
-  return component_.at(name).joint.axis;
+  return joint_axis_.at(getComponentIndex(name));
 }
 
 double Manipulator::getComponentJointAngle(Name name)
 {
-  return component_.at(name).joint.angle;
+  return joint_angle_.at(getComponentIndex(name));
 }
 
 double Manipulator::getComponentJointVelocity(Name name)
 {
-  return component_.at(name).joint.velocity;
+  return joint_velocity_.at(getComponentIndex(name));
 }
 
 double Manipulator::getComponentJointAcceleration(Name name)
 {
-  return component_.at(name).joint.acceleration;
+  return joint_acceleration_.at(getComponentIndex(name));
 }
 
 Tool Manipulator::getComponentTool(Name name)
@@ -561,12 +770,12 @@ double Manipulator::getComponentMass(Name name)
   return component_.at(name).inertia.mass;
 }
 
-Matrix3f Manipulator::getComponentInertiaTensor(Name name)
+Matrix3r Manipulator::getComponentInertiaTensor(Name name)
 {
   return component_.at(name).inertia.inertia_tensor;
 }
 
-Vector3f Manipulator::getComponentCenterOfMass(Name name)
+Vector3r Manipulator::getComponentCenterOfMass(Name name)
 {
   return component_.at(name).inertia.center_of_mass;
 }
@@ -574,14 +783,16 @@ Vector3f Manipulator::getComponentCenterOfMass(Name name)
 std::vector<double> Manipulator::getAllJointAngle()
 {
   std::vector<double> result_vector;
-  std::map<Name, Component>::iterator it;
 
-  for (it = component_.begin(); it != component_.end(); it++)
+  if (!compiled_)
+    compileComponent();
+
+  for (uint8_t index = 0; index < index_name_.size(); index++)
   {
-    if (component_.at(it->first).tool.id == -1) // Check whether Tool or not
+    if (tool_id_[index] == -1) // Check whether Tool or not
     {
       // This is not Tool -> This is Joint
-      result_vector.push_back(component_.at(it->first).joint.angle);
+      result_vector.push_back(joint_angle_[index]);
     }
   }
   return result_vector;
@@ -590,31 +801,377 @@ std::vector<double> Manipulator::getAllJointAngle()
 std::vector<double> Manipulator::getAllActiveJointAngle()
 {
   std::vector<double> result_vector;
-  std::map<Name, Component>::iterator it;
 
-  for (it = component_.begin(); it != component_.end(); it++)
+  getAllActiveJointAngle(&result_vector);
+  return result_vector;
+}
+
+void Manipulator::getAllActiveJointAngle(std::vector<double> *angle_vector)
+{
+  if (!compiled_)
+    compileComponent();
+
+  angle_vector->resize(active_joint_index_.size());
+  for (uint8_t index = 0; index < active_joint_index_.size(); index++)
+    (*angle_vector)[index] = joint_angle_[active_joint_index_[index]];
+}
+
+void Manipulator::getAllActiveJointMotionLimit(std::vector<double> *max_velocity, std::vector<double> *max_acceleration, std::vector<double> *max_jerk)
+{
+  if (!compiled_)
+    compileComponent();
+
+  max_velocity->resize(active_joint_index_.size());
+  max_acceleration->resize(active_joint_index_.size());
+  max_jerk->resize(active_joint_index_.size());
+  for (uint8_t index = 0; index < active_joint_index_.size(); index++)
   {
-    if (component_.at(it->first).joint.id != -1) // Check whether Active or Passive
-    {
-      // Active
-      result_vector.push_back(component_.at(it->first).joint.angle);
-    }
+    const Joint &joint = component_.at(index_name_[active_joint_index_[index]]).joint;
+    (*max_velocity)[index] = joint.max_velocity;
+    (*max_acceleration)[index] = joint.max_acceleration;
+    (*max_jerk)[index] = joint.max_jerk;
+  }
+}
+
+void Manipulator::getAllActiveJointAngleLimit(std::vector<double> *min_angle, std::vector<double> *max_angle)
+{
+  if (!compiled_)
+    compileComponent();
+
+  min_angle->resize(active_joint_index_.size());
+  max_angle->resize(active_joint_index_.size());
+  for (uint8_t index = 0; index < active_joint_index_.size(); index++)
+  {
+    (*min_angle)[index] = joint_min_angle_[active_joint_index_[index]];
+    (*max_angle)[index] = joint_max_angle_[active_joint_index_[index]];
   }
-  return result_vector;
 }
 
 std::vector<uint8_t> Manipulator::getAllActiveJointID()
 {
   std::vector<uint8_t> active_joint_id;
-  std::map<Name, Component>::iterator it;
 
-  for (it = component_.begin(); it != component_.end(); it++)
+  if (!compiled_)
+    compileComponent();
+
+  active_joint_id.reserve(active_joint_index_.size());
+  for (uint8_t index = 0; index < active_joint_index_.size(); index++)
+    active_joint_id.push_back(joint_id_[active_joint_index_[index]]);
+
+  return active_joint_id;
+}
+
+///////////////////////////////Index function////////////////////////////////
+
+int16_t Manipulator::getComponentIndex(Name name)
+{
+  if (!compiled_)
+    compileComponent();
+
+  return index_[(uint8_t)name];
+}
+
+Name Manipulator::getComponentNameByIndex(int16_t index)
+{
+  if (!compiled_)
+    compileComponent();
+
+  return index_name_.at(index);
+}
+
+int16_t Manipulator::getComponentParentIndex(int16_t index)
+{
+  if (!compiled_)
+    compileComponent();
+
+  return parent_index_.at(index);
+}
+
+const std::vector<int16_t> &Manipulator::getForwardOrder()
+{
+  if (!compiled_)
+    compileComponent();
+
+  return forward_order_;
+}
+
+const std::vector<double> &Manipulator::getAllActiveJointCoefficient()
+{
+  if (!compiled_)
+    compileComponent();
+
+  return active_joint_coefficient_;
+}
+
+const std::vector<uint8_t> &Manipulator::getAllActiveJointReceiveOrder()
+{
+  if (!compiled_)
+    compileComponent();
+
+  return active_joint_receive_order_;
+}
+
+int16_t Manipulator::getActiveJointIndexById(uint8_t joint_id)
+{
+  if (!compiled_)
+    compileComponent();
+
+  return active_joint_by_id_[joint_id];
+}
+
+int16_t Manipulator::getSubtreeEnd(int16_t index)
+{
+  if (!compiled_)
+    compileComponent();
+
+  return subtree_end_.at(index);
+}
+
+///////////////////////////////Kinematics function///////////////////////////
+
+void Manipulator::setPoseDirty(int16_t index)
+{
+  pose_dirty_[index] = true;
+  has_dirty_pose_ = true;
+}
+
+void Manipulator::setPoseClean(int16_t index)
+{
+  // An external write owns the pose; keep the built-in update off the subtree
+  if (forward_order_position_[index] == -1)
+    return;
+
+  for (int16_t order = forward_order_position_[index]; order < subtree_end_[index]; order++)
+    pose_dirty_[forward_order_[order]] = false;
+}
+
+void Manipulator::setWorldDirty()
+{
+  if (!compiled_)
+    return;
+
+  for (int16_t index = 0; index < (int16_t)parent_index_.size(); index++)
   {
-    if (component_.at(it->first).joint.id != -1)
+    if (parent_index_[index] == -1)
+      setPoseDirty(index);
+  }
+}
+
+void Manipulator::updateLazyPose()
+{
+  if (lazy_forward_ && has_dirty_pose_)
+    forwardKinematics();
+}
+
+void Manipulator::updatePoseToWorld(uint8_t begin, uint8_t end)
+{
+  // A dirty component invalidates its whole subtree; clean subtrees are skipped.
+  uint8_t dirty_end = begin;
+
+  for (uint8_t order = begin; order < end; order++)
+  {
+    int16_t index = forward_order_[order];
+    int16_t parent = parent_index_[index];
+
+    if (order >= dirty_end)
     {
-      active_joint_id.push_back(component_.at(it->first).joint.id);
+      if (!pose_dirty_[index])
+        continue;
+      dirty_end = subtree_end_[index];
     }
+    pose_dirty_[index] = false;
+
+    const Vector3r &parent_position = (parent == -1) ? world_.pose.position : position_to_world_[parent];
+    const Matrix3r &parent_orientation = (parent == -1) ? world_.pose.orientation : orientation_to_world_[parent];
+
+    position_to_world_[index] = parent_position + parent_orientation * relative_position_[index];
+    orientation_to_world_[index] = parent_orientation * relative_orientation_[index] *
+                                   RM_MATH::rodriguesRotationMatrix(joint_axis_[index], joint_angle_[index]);
+    joint_axis_to_world_[index] = orientation_to_world_[index] * joint_axis_[index];
   }
-  return active_joint_id;
 }
 
+void Manipulator::forwardKinematics()
+{
+  if (!compiled_)
+    compileComponent();
+
+  if (!has_dirty_pose_)
+    return;
+
+  updatePoseToWorld(0, forward_order_.size());
+  has_dirty_pose_ = false;
+}
+
+void Manipulator::forwardKinematics(Name component_name)
+{
+  int16_t first = getComponentIndex(component_name);
+
+  if (first == -1 || forward_order_position_[first] == -1)
+  {
+    //error
+    return;
+  }
+
+  updatePoseToWorld(forward_order_position_[first], subtree_end_[first]);
+}
+
+void Manipulator::forwardKinematics(Name tool_name, const MatrixXr &joint_angle, MatrixXr *tool_position, MatrixXr *tool_orientation)
+{
+  int16_t tool = getComponentIndex(tool_name);
+  uint32_t size = joint_angle.rows();
+
+  tool_position->resize(size, 3);
+  tool_orientation->resize(size, 9);
+  if (tool == -1 || joint_angle.cols() != (int)active_joint_index_.size())
+  {
+    //error
+    return;
+  }
+
+  std::vector<int16_t> path;
+  for (int16_t index = tool; index != -1; index = parent_index_[index])
+    path.push_back(index);
+
+  for (uint8_t row = 0; row < 3; row++)
+  {
+    tool_position->col(row).setConstant(world_.pose.position(row));
+    for (uint8_t col = 0; col < 3; col++)
+      tool_orientation->col(row * 3 + col).setConstant(world_.pose.orientation(row, col));
+  }
+
+  // Every configuration is a row, so each column operation below runs over all
+  // configurations at once and Eigen vectorizes it, sin/cos included.
+  MatrixXr link(size, 9);
+  MatrixXr orientation(size, 9);
+  VectorXr sine(size);
+  VectorXr versine(size);
+
+  for (int16_t step = path.size() - 1; step >= 0; step--)
+  {
+    int16_t index = path[step];
+    const Vector3r &relative_position = relative_position_[index];
+
+    for (uint8_t row = 0; row < 3; row++)
+    {
+      tool_position->col(row) += tool_orientation->col(row * 3) * relative_position(0) +
+                                 tool_orientation->col(row * 3 + 1) * relative_position(1) +
+                                 tool_orientation->col(row * 3 + 2) * relative_position(2);
+    }
+
+    // relative_orientation * rodrigues(axis, q) = A + B sin(q) + C (1 - cos(q))
+    Matrix3r skew = RM_MATH::skewSymmetricMatrix(joint_axis_[index]);
+    Matrix3r A = relative_orientation_[index];
+    Matrix3r B = A * skew;
+    Matrix3r C = B * skew;
+
+    int16_t column = (joint_id_[index] == -1) ? -1 : active_joint_by_id_[(uint8_t)joint_id_[index]];
+    if (column == -1)
+    {
+      sine.setConstant(sin(joint_angle_[index]));
+      versine.setConstant(1.0 - cos(joint_angle_[index]));
+    }
+    else
+    {
+      sine = joint_angle.col(column).array().sin();
+      versine = 1.0 - joint_angle.col(column).array().cos();
+    }
+
+    for (uint8_t row = 0; row < 3; row++)
+    {
+      for (uint8_t col = 0; col < 3; col++)
+        link.col(row * 3 + col) = (A(row, col) + B(row, col) * sine.array() + C(row, col) * versine.array()).matrix();
+    }
+
+    for (uint8_t row = 0; row < 3; row++)
+    {
+      for (uint8_t col = 0; col < 3; col++)
+      {
+        orientation.col(row * 3 + col) = (tool_orientation->col(row * 3).array() * link.col(col).array() +
+                                          tool_orientation->col(row * 3 + 1).array() * link.col(3 + col).array() +
+                                          tool_orientation->col(row * 3 + 2).array() * link.col(6 + col).array()).matrix();
+      }
+    }
+    tool_orientation->swap(orientation);
+  }
+}
+
+void Manipulator::jacobian(Name tool_name, MatrixXr *jacobian_matrix)
+{
+  int16_t tool = getComponentIndex(tool_name);
+
+  forwardKinematics();
+
+  jacobian_matrix->resize(6, active_joint_index_.size());
+  jacobian_matrix->setZero();
+  if (tool == -1)
+  {
+    //error
+    return;
+  }
+
+  // Geometric Jacobian from the world joint axes and positions of the FK pass.
+  // Only the joints on the path from the tool to the world move the tool.
+  const Vector3r &tool_position = position_to_world_[tool];
+
+  for (int16_t index = tool; index != -1; index = parent_index_[index])
+  {
+    if (joint_id_[index] == -1)
+      continue;
+
+    int16_t column = active_joint_by_id_[(uint8_t)joint_id_[index]];
+    const Vector3r &axis = joint_axis_to_world_[index];
+
+    jacobian_matrix->block<3, 1>(0, column) = axis.cross(tool_position - position_to_world_[index]);
+    jacobian_matrix->block<3, 1>(3, column) = axis;
+  }
+}
+
+void Manipulator::setLazyForwardKinematics(bool lazy)
+{
+  lazy_forward_ = lazy;
+}
+
+bool Manipulator::getLazyForwardKinematics()
+{
+  return lazy_forward_;
+}
+
+/////////////////////////////////Kinematics/////////////////////////////////
+
+void Kinematics::forward(Manipulator *manipulator)
+{
+  manipulator->forwardKinematics();
+}
+
+void Kinematics::forward(Manipulator *manipulator, Name component_name)
+{
+  manipulator->forwardKinematics(component_name);
+}
+
+MatrixXr Kinematics::jacobian(Manipulator *manipulator, Name tool_name)
+{
+  MatrixXr jacobian_matrix;
+
+  manipulator->jacobian(tool_name, &jacobian_matrix);
+  return jacobian_matrix;
+}
+
+//////////////////////////////////Actuator//////////////////////////////////
+
+bool Actuator::writeAllActuatorAngle(const std::vector<double> &radian_vector)
+{
+  return sendAllActuatorAngle(radian_vector);
+}
+
+//////////////////////////////////Drawing//////////////////////////////////
+
+void Drawing::getState(double tick, Pose *pose, Pose *pose_vel, Pose *pose_acc)
+{
+  *pose = getPose(tick);
+
+  pose_vel->position.setZero();
+  pose_vel->orientation.setZero();
+  pose_acc->position.setZero();
+  pose_acc->orientation.setZero();
+}
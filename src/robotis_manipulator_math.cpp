@@ -21,7 +21,7 @@
 
 using namespace Eigen;
 
-float RM_MATH::sign(float number)
+Real RM_MATH::sign(Real number)
 {
   if (number >= 0.0)
   {
@@ -33,30 +33,30 @@ float RM_MATH::sign(float number)
   }
 }
 
-Vector3f RM_MATH::makeVector3(float v1, float v2, float v3)
+Vector3r RM_MATH::makeVector3(Real v1, Real v2, Real v3)
 {
-  Vector3f temp;
+  Vector3r temp;
   temp << v1, v2, v3;
   return temp;
 }
 
-Matrix3f RM_MATH::makeMatrix3(float m11, float m12, float m13,
-                           float m21, float m22, float m23,
-                           float m31, float m32, float m33)
+Matrix3r RM_MATH::makeMatrix3(Real m11, Real m12, Real m13,
+                           Real m21, Real m22, Real m23,
+                           Real m31, Real m32, Real m33)
 {
-  Matrix3f temp;
+  Matrix3r temp;
   temp << m11, m12, m13, m21, m22, m23, m31, m32, m33;
   return temp;
 }
 
-Vector3f RM_MATH::matrixLogarithm(Matrix3f rotation_matrix)
+Vector3r RM_MATH::matrixLogarithm(Matrix3r rotation_matrix)
 {
-  Matrix3f R = rotation_matrix;
-  Vector3f l = Vector3f::Zero();
-  Vector3f rotation_vector = Vector3f::Zero();
+  Matrix3r R = rotation_matrix;
+  Vector3r l = Vector3r::Zero();
+  Vector3r rotation_vector = Vector3r::Zero();
 
-  float theta = 0.0;
-  float diag = 0.0;
+  Real theta = 0.0;
+  Real diag = 0.0;
   bool diagonal_matrix = R.isDiagonal();
 
   l << R(2, 1) - R(1, 2),
@@ -83,20 +83,20 @@ Vector3f RM_MATH::matrixLogarithm(Matrix3f rotation_matrix)
   return rotation_vector;
 }
 
-Matrix3f RM_MATH::skewSymmetricMatrix(Vector3f v)
+Matrix3r RM_MATH::skewSymmetricMatrix(Vector3r v)
 {
-  Matrix3f skew_symmetric_matrix = Matrix3f::Zero();
+  Matrix3r skew_symmetric_matrix = Matrix3r::Zero();
   skew_symmetric_matrix << 0, -v(2), v(1),
       v(2), 0, -v(0),
       -v(1), v(0), 0;
   return skew_symmetric_matrix;
 }
 
-Matrix3f RM_MATH::rodriguesRotationMatrix(Vector3f axis, float angle)
+Matrix3r RM_MATH::rodriguesRotationMatrix(Vector3r axis, Real angle)
 {
-  Matrix3f skew_symmetric_matrix = Matrix3f::Zero();
-  Matrix3f rotation_matrix = Matrix3f::Zero();
-  Matrix3f Identity_matrix = Matrix3f::Identity();
+  Matrix3r skew_symmetric_matrix = Matrix3r::Zero();
+  Matrix3r rotation_matrix = Matrix3r::Zero();
+  Matrix3r Identity_matrix = Matrix3r::Identity();
 
   skew_symmetric_matrix = skewSymmetricMatrix(axis);
   rotation_matrix = Identity_matrix +
@@ -105,7 +105,7 @@ Matrix3f RM_MATH::rodriguesRotationMatrix(Vector3f axis, float angle)
   return rotation_matrix;
 }
 
-Matrix3f RM_MATH::makeRotationMatrix(float roll, float pitch, float yaw)
+Matrix3r RM_MATH::makeRotationMatrix(Real roll, Real pitch, Real yaw)
 {
 #if 0 // Euler angle
   Eigen::Matrix3f rotation_matrix = Eigen::Matrix3f::Identity();
@@ -117,7 +117,7 @@ Matrix3f RM_MATH::makeRotationMatrix(float roll, float pitch, float yaw)
   return rotation_matrix;
 #endif
 
-  Vector3f rotation_vector;
+  Vector3r rotation_vector;
 
   rotation_vector(0) = roll;
   rotation_vector(1) = pitch;
@@ -126,11 +126,11 @@ Matrix3f RM_MATH::makeRotationMatrix(float roll, float pitch, float yaw)
   return makeRotationMatrix(rotation_vector);
 }
 
-Matrix3f RM_MATH::makeRotationMatrix(Vector3f rotation_vector)
+Matrix3r RM_MATH::makeRotationMatrix(Vector3r rotation_vector)
 {
-  Matrix3f rotation_matrix;
-  Vector3f axis;
-  float angle;
+  Matrix3r rotation_matrix;
+  Vector3r axis;
+  Real angle;
 
   angle = rotation_vector.norm();
   axis(0) = rotation_vector(0) / angle;
@@ -141,33 +141,33 @@ Matrix3f RM_MATH::makeRotationMatrix(Vector3f rotation_vector)
   return rotation_matrix;
 }
 
-Vector3f RM_MATH::makeRotationVector(Matrix3f rotation_matrix)
+Vector3r RM_MATH::makeRotationVector(Matrix3r rotation_matrix)
 {
   return matrixLogarithm(rotation_matrix);
 }
 
-Vector3f RM_MATH::positionDifference(Vector3f desired_position, Vector3f present_position)
+Vector3r RM_MATH::positionDifference(Vector3r desired_position, Vector3r present_position)
 {
-  Vector3f position_difference;
+  Vector3r position_difference;
   position_difference = desired_position - present_position;
 
   return position_difference;
 }
 
-Vector3f RM_MATH::orientationDifference(Matrix3f desired_orientation, Matrix3f present_orientation)
+Vector3r RM_MATH::orientationDifference(Matrix3r desired_orientation, Matrix3r present_orientation)
 {
-  Vector3f orientation_difference;
+  Vector3r orientation_difference;
   orientation_difference = present_orientation * makeRotationVector(present_orientation.transpose() * desired_orientation);                   
 
   return orientation_difference;
 }
 
-VectorXf RM_MATH::poseDifference(Vector3f desired_position, Vector3f present_position,
-                              Matrix3f desired_orientation, Matrix3f present_orientation)
+VectorXr RM_MATH::poseDifference(Vector3r desired_position, Vector3r present_position,
+                              Matrix3r desired_orientation, Matrix3r present_orientation)
 {
-  Vector3f position_difference;
-  Vector3f orientation_difference;
-  VectorXf pose_difference(6);
+  Vector3r position_difference;
+  Vector3r orientation_difference;
+  VectorXr pose_difference(6);
 
   position_difference = positionDifference(desired_position, present_position);
   orientation_difference = orientationDifference(desired_orientation, present_orientation);
@@ -176,3 +176,11 @@ VectorXf RM_MATH::poseDifference(Vector3f desired_position, Vector3f present_pos
 
   return pose_difference;
 }
+
+void RM_MATH::poseDifference(const Vector3r &desired_position, const Vector3r &present_position,
+                             const Matrix3r &desired_orientation, const Matrix3r &present_orientation,
+                             Vector6r *pose_difference)
+{
+  pose_difference->head<3>() = positionDifference(desired_position, present_position);
+  pose_difference->tail<3>() = orientationDifference(desired_orientation, present_orientation);
+}
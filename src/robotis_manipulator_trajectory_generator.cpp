@@ -18,12 +18,14 @@
 
 #include "robotis_manipulator/robotis_manipulator_trajectory_generator.h"
 
+#include <algorithm>
+
 using namespace ROBOTIS_MANIPULATOR;
 using namespace Eigen;
 
 MinimumJerk::MinimumJerk()
 {
-  coefficient_ = VectorXf::Zero(6);
+  coefficient_ = VectorXr::Zero(6);
 }
 
 MinimumJerk::~MinimumJerk() {}
@@ -32,213 +34,793 @@ void MinimumJerk::calcCoefficient(Trajectory start,
                                   Trajectory goal,
                                   double move_time,
                                   double control_time)
+{
+  std::vector<Trajectory> start_vector(1, start);
+  std::vector<Trajectory> goal_vector(1, goal);
+  MatrixXr coefficient;
+
+  calcCoefficient(start_vector, goal_vector, move_time, control_time, &coefficient);
+  coefficient_ = coefficient.col(0);
+}
+
+void MinimumJerk::calcCoefficient(const std::vector<Trajectory> &start,
+                                  const std::vector<Trajectory> &goal,
+                                  double move_time,
+                                  double control_time,
+                                  MatrixXr *coefficient)
 {
   uint16_t step_time = uint16_t(floor(move_time / control_time) + 1.0);
   move_time = double(step_time - 1) * control_time;
 
-  Matrix3f A = Matrix3f::Identity(3, 3);
-  Vector3f x = Vector3f::Zero();
-  Vector3f b = Vector3f::Zero();
+  uint8_t size = start.size();
+  coefficient->resize(6, size);
 
-  A << pow(move_time, 3), pow(move_time, 4), pow(move_time, 5),
-      3 * pow(move_time, 2), 4 * pow(move_time, 3), 5 * pow(move_time, 4),
-      6 * pow(move_time, 1), 12 * pow(move_time, 2), 20 * pow(move_time, 3);
+  double T = move_time;
+  double T2 = T * T;
+  double T3 = T2 * T;
 
-  coefficient_(0) = start.position;
-  coefficient_(1) = start.velocity;
-  coefficient_(2) = 0.5 * start.acceleration;
+  // No time to move: hold the start position
+  if (T <= 0.0)
+  {
+    coefficient->setZero();
+    for (uint8_t index = 0; index < size; index++)
+      (*coefficient)(0, index) = start[index].position;
+    return;
+  }
+
+  // Closed-form inverse of the boundary condition matrix
+  //   | T^3    T^4     T^5   |
+  //   | 3T^2   4T^3    5T^4  |
+  //   | 6T     12T^2   20T^3 |
+  // which depends only on the move time, so one inverse serves every axis.
+  Matrix3r inverse;
+  inverse << 10.0 / T3,         -4.0 / T2,        0.5 / T,
+             -15.0 / (T3 * T),  7.0 / T3,         -1.0 / T2,
+             6.0 / (T3 * T2),   -3.0 / (T3 * T),  0.5 / T3;
+
+  Matrix<Real, 3, Dynamic> b(3, size);
+  for (uint8_t index = 0; index < size; index++)
+  {
+    const Trajectory &s = start[index];
+    const Trajectory &g = goal[index];
 
-  b << (goal.position - start.position - (start.velocity * move_time + 0.5 * start.acceleration * pow(move_time, 2))),
-      (goal.velocity - start.velocity - (start.acceleration * move_time)),
-      (goal.acceleration - start.acceleration);
+    (*coefficient)(0, index) = s.position;
+    (*coefficient)(1, index) = s.velocity;
+    (*coefficient)(2, index) = 0.5 * s.acceleration;
 
-  ColPivHouseholderQR<Matrix3f> dec(A);
-  x = dec.solve(b);
+    b(0, index) = g.position - (s.position + s.velocity * T + 0.5 * s.acceleration * T2);
+    b(1, index) = g.velocity - (s.velocity + s.acceleration * T);
+    b(2, index) = g.acceleration - s.acceleration;
+  }
 
-  coefficient_(3) = x(0);
-  coefficient_(4) = x(1);
-  coefficient_(5) = x(2);
+  coefficient->bottomRows(3).noalias() = inverse * b;
 }
 
-VectorXf MinimumJerk::getCoefficient()
+VectorXr MinimumJerk::getCoefficient()
 {
   return coefficient_;
 }
 
-//-------------------- Joint trajectory --------------------//
+//-------------------- Velocity profile --------------------//
+
+MinimumJerkProfile::MinimumJerkProfile() : move_time_(1.0) {}
 
-JointTrajectory::JointTrajectory(uint8_t joint_num)
+MinimumJerkProfile::~MinimumJerkProfile() {}
+
+void MinimumJerkProfile::init(double move_time)
 {
-  joint_num_ = joint_num;
-  coefficient_ = MatrixXf::Identity(6, joint_num);
-  position_.reserve(joint_num);
-  velocity_.reserve(joint_num);
-  acceleration_.reserve(joint_num);
+  move_time_ = move_time;
 }
 
-JointTrajectory::~JointTrajectory() {}
+void MinimumJerkProfile::getState(double tick, double *s, double *ds, double *dds)
+{
+  double T = move_time_;
+  double tau = std::min(std::max(tick / T, 0.0), 1.0);
+
+  *s = tau * tau * tau * (10.0 + tau * (-15.0 + tau * 6.0));
+  *ds = tau * tau * (30.0 + tau * (-60.0 + tau * 30.0)) / T;
+  *dds = tau * (60.0 + tau * (-180.0 + tau * 120.0)) / (T * T);
+}
 
-void JointTrajectory::init(std::vector<Trajectory> start,
-                           std::vector<Trajectory> goal,
-                           double move_time,
-                           double control_time)
+double MinimumJerkProfile::getMoveTime()
 {
-  for (uint8_t index = 0; index < start.size(); index++)
+  return move_time_;
+}
+
+DoubleSProfile::DoubleSProfile()
+{
+  init(1.0, 1.0 / 3.0, 1.0 / 9.0);
+}
+
+DoubleSProfile::~DoubleSProfile() {}
+
+void DoubleSProfile::init(double move_time, double acceleration_time, double jerk_time)
+{
+  move_time_ = move_time;
+  acceleration_time_ = std::min(std::max(acceleration_time, 0.0), 0.5 * move_time);
+  jerk_time_ = std::min(std::max(jerk_time, 0.0), 0.5 * acceleration_time_);
+
+  // The unit distance is covered at the peak velocity in (T - Ta)
+  velocity_ = 1.0 / (move_time_ - acceleration_time_);
+  acceleration_ = (acceleration_time_ > 0.0) ? velocity_ / (acceleration_time_ - jerk_time_) : 0.0;
+  jerk_ = (jerk_time_ > 0.0) ? acceleration_ / jerk_time_ : 0.0;
+}
+
+void DoubleSProfile::initFastest(double max_velocity, double max_acceleration, double max_jerk)
+{
+  // Closed-form rest to rest solution (Biagiotti and Melchiorri, 3.4).
+  // Unlimited quantities are capped so the arithmetic stays finite.
+  double v = std::min(max_velocity, 1e12);
+  double a = std::min(max_acceleration, 1e12);
+  double j = std::min(max_jerk, 1e12);
+  double Tj, Ta, Tv;
+
+  if (v * j >= a * a)
+  {
+    Tj = a / j;
+    Ta = Tj + v / a;
+  }
+  else
   {
-    trajectory_generator_.calcCoefficient(start.at(index),
-                                    goal.at(index),
-                                    move_time,
-                                    control_time);
+    Tj = sqrt(v / j);
+    Ta = 2.0 * Tj;
+  }
+  Tv = 1.0 / v - Ta;
 
-    coefficient_.col(index) = trajectory_generator_.getCoefficient();
+  // The peak velocity is not reached: no constant velocity phase
+  if (Tv < 0.0)
+  {
+    Tv = 0.0;
+    Tj = a / j;
+    Ta = (a * a / j + sqrt(a * a * a * a / (j * j) + 4.0 * a)) / (2.0 * a);
+    if (Ta < 2.0 * Tj)
+    {
+      Tj = cbrt(1.0 / (2.0 * j));
+      Ta = 2.0 * Tj;
+    }
   }
+
+  init(2.0 * Ta + Tv, Ta, Tj);
 }
 
-std::vector<double> JointTrajectory::getPosition(double tick)
+void DoubleSProfile::getAccelerationState(double tick, double *s, double *ds, double *dds)
 {
-  position_.clear();
-  for (uint8_t index = 0; index < joint_num_; index++)
+  double t = tick;
+  double Ta = acceleration_time_;
+  double Tj = jerk_time_;
+
+  if (t < Tj)
   {
-    double result = 0.0;
-    result = coefficient_(0, index) +
-             coefficient_(1, index) * pow(tick, 1) +
-             coefficient_(2, index) * pow(tick, 2) +
-             coefficient_(3, index) * pow(tick, 3) +
-             coefficient_(4, index) * pow(tick, 4) +
-             coefficient_(5, index) * pow(tick, 5);
+    *s = jerk_ * t * t * t / 6.0;
+    *ds = 0.5 * jerk_ * t * t;
+    *dds = jerk_ * t;
+  }
+  else if (t < Ta - Tj)
+  {
+    *s = acceleration_ / 6.0 * (3.0 * t * t - 3.0 * Tj * t + Tj * Tj);
+    *ds = acceleration_ * (t - 0.5 * Tj);
+    *dds = acceleration_;
+  }
+  else
+  {
+    double r = Ta - t;
+    *s = 0.5 * velocity_ * Ta - velocity_ * r + jerk_ * r * r * r / 6.0;
+    *ds = velocity_ - 0.5 * jerk_ * r * r;
+    *dds = jerk_ * r;
+  }
+}
+
+void DoubleSProfile::getState(double tick, double *s, double *ds, double *dds)
+{
+  double T = move_time_;
+  double Ta = acceleration_time_;
+  double t = std::min(std::max(tick, 0.0), T);
 
-    position_.push_back(result);
+  if (t < Ta)
+  {
+    getAccelerationState(t, s, ds, dds);
+  }
+  else if (t <= T - Ta)
+  {
+    *s = velocity_ * (t - 0.5 * Ta);
+    *ds = velocity_;
+    *dds = 0.0;
+  }
+  else
+  {
+    // The deceleration mirrors the acceleration
+    getAccelerationState(T - t, s, ds, dds);
+    *s = 1.0 - *s;
+    *dds = -*dds;
   }
+}
 
-  return position_;
+double DoubleSProfile::getMoveTime()
+{
+  return move_time_;
 }
 
-std::vector<double> JointTrajectory::getVelocity(double tick)
+double DoubleSProfile::getAccelerationTime()
 {
-  velocity_.clear();
-  for (uint8_t index = 0; index < joint_num_; index++)
+  return acceleration_time_;
+}
+
+double DoubleSProfile::getJerkTime()
+{
+  return jerk_time_;
+}
+
+TrapezoidalProfile::TrapezoidalProfile()
+{
+  init(1.0, 1.0 / 3.0);
+}
+
+TrapezoidalProfile::~TrapezoidalProfile() {}
+
+void TrapezoidalProfile::init(double move_time, double acceleration_time)
+{
+  DoubleSProfile::init(move_time, acceleration_time, 0.0);
+}
+
+void TrapezoidalProfile::initFastest(double max_velocity, double max_acceleration)
+{
+  DoubleSProfile::initFastest(max_velocity, max_acceleration, DBL_MAX);
+  init(move_time_, acceleration_time_);
+}
+
+//-------------------- Axis trajectory --------------------//
+
+AxisTrajectory::AxisTrajectory(uint8_t axis_num)
+{
+  axis_num_ = axis_num;
+  coefficient_ = MatrixXr::Identity(6, axis_num);
+  power_coefficient_ = coefficient_.transpose();
+  position_.reserve(axis_num);
+  velocity_.reserve(axis_num);
+  acceleration_.reserve(axis_num);
+
+  profile_type_ = MINIMUM_JERK_PROFILE;
+  acceleration_ratio_ = 1.0 / 3.0;
+  jerk_ratio_ = 1.0 / 3.0;
+  profile_ = NULL;
+}
+
+AxisTrajectory::~AxisTrajectory() {}
+
+void AxisTrajectory::init(std::vector<Trajectory> start,
+                          std::vector<Trajectory> goal,
+                          double move_time,
+                          double control_time)
+{
+  axis_num_ = start.size();
+  trajectory_generator_.calcCoefficient(start, goal, move_time, control_time, &coefficient_);
+  power_coefficient_ = coefficient_.transpose();
+
+  profile_ = NULL;
+  if (profile_type_ == MINIMUM_JERK_PROFILE)
+    return;
+
+  start_position_.resize(start.size());
+  distance_.resize(start.size());
+  for (uint8_t index = 0; index < start.size(); index++)
   {
-    double result = 0.0;
-    result = coefficient_(1, index) +
-             2 * coefficient_(2, index) * pow(tick, 1) +
-             3 * coefficient_(3, index) * pow(tick, 2) +
-             4 * coefficient_(4, index) * pow(tick, 3) +
-             5 * coefficient_(5, index) * pow(tick, 4);
+    if (start.at(index).velocity != 0.0 || start.at(index).acceleration != 0.0 ||
+        goal.at(index).velocity != 0.0 || goal.at(index).acceleration != 0.0)
+      return;
 
-    velocity_.push_back(result);
+    start_position_[index] = start.at(index).position;
+    distance_[index] = goal.at(index).position - start.at(index).position;
   }
 
-  return velocity_;
+  uint16_t step_time = uint16_t(floor(move_time / control_time) + 1.0);
+  move_time = double(step_time - 1) * control_time;
+  if (move_time <= 0.0)
+    return;
+
+  if (profile_type_ == TRAPEZOIDAL_PROFILE)
+  {
+    trapezoidal_profile_.init(move_time, acceleration_ratio_ * move_time);
+    profile_ = &trapezoidal_profile_;
+  }
+  else if (profile_type_ == DOUBLE_S_PROFILE)
+  {
+    double_s_profile_.init(move_time, acceleration_ratio_ * move_time, jerk_ratio_ * acceleration_ratio_ * move_time);
+    profile_ = &double_s_profile_;
+  }
 }
 
-std::vector<double> JointTrajectory::getAcceleration(double tick)
+void AxisTrajectory::setProfile(Name profile_type, double acceleration_ratio, double jerk_ratio)
 {
-  acceleration_.clear();
-  for (uint8_t index = 0; index < joint_num_; index++)
+  profile_type_ = profile_type;
+  acceleration_ratio_ = acceleration_ratio;
+  jerk_ratio_ = jerk_ratio;
+}
+
+Name AxisTrajectory::getProfile()
+{
+  return profile_type_;
+}
+
+std::vector<double> AxisTrajectory::getPosition(double tick)
+{
+  getPosition(tick, &position_);
+  return position_;
+}
+
+void AxisTrajectory::getPosition(double tick, std::vector<double> *position)
+{
+  if (profile_ != NULL)
   {
-    double result = 0.0;
+    double s, ds, dds;
+    profile_->getState(tick, &s, &ds, &dds);
+    position->resize(axis_num_);
+    for (uint8_t index = 0; index < axis_num_; index++)
+      (*position)[index] = start_position_[index] + distance_[index] * s;
+    return;
+  }
+
+  const MatrixXr &c = power_coefficient_;
+  Real t = tick;
 
-    result = 2 * coefficient_(2, index) +
-             6 * coefficient_(3, index) * pow(tick, 1) +
-             12 * coefficient_(4, index) * pow(tick, 2) +
-             20 * coefficient_(5, index) * pow(tick, 3);
+  position->resize(axis_num_);
+  Map<Matrix<double, Dynamic, 1> >(position->data(), axis_num_) =
+      (((((c.col(5) * t + c.col(4)) * t + c.col(3)) * t + c.col(2)) * t + c.col(1)) * t + c.col(0)).cast<double>();
+}
 
-    acceleration_.push_back(result);
+std::vector<double> AxisTrajectory::getVelocity(double tick)
+{
+  getVelocity(tick, &velocity_);
+  return velocity_;
+}
+
+void AxisTrajectory::getVelocity(double tick, std::vector<double> *velocity)
+{
+  if (profile_ != NULL)
+  {
+    double s, ds, dds;
+    profile_->getState(tick, &s, &ds, &dds);
+    velocity->resize(axis_num_);
+    for (uint8_t index = 0; index < axis_num_; index++)
+      (*velocity)[index] = distance_[index] * ds;
+    return;
   }
 
+  const MatrixXr &c = power_coefficient_;
+  Real t = tick;
+
+  velocity->resize(axis_num_);
+  Map<Matrix<double, Dynamic, 1> >(velocity->data(), axis_num_) =
+      ((((5 * c.col(5) * t + 4 * c.col(4)) * t + 3 * c.col(3)) * t + 2 * c.col(2)) * t + c.col(1)).cast<double>();
+}
+
+std::vector<double> AxisTrajectory::getAcceleration(double tick)
+{
+  getAcceleration(tick, &acceleration_);
   return acceleration_;
 }
 
-MatrixXf JointTrajectory::getCoefficient()
+void AxisTrajectory::getAcceleration(double tick, std::vector<double> *acceleration)
+{
+  if (profile_ != NULL)
+  {
+    double s, ds, dds;
+    profile_->getState(tick, &s, &ds, &dds);
+    acceleration->resize(axis_num_);
+    for (uint8_t index = 0; index < axis_num_; index++)
+      (*acceleration)[index] = distance_[index] * dds;
+    return;
+  }
+
+  const MatrixXr &c = power_coefficient_;
+  Real t = tick;
+
+  acceleration->resize(axis_num_);
+  Map<Matrix<double, Dynamic, 1> >(acceleration->data(), axis_num_) =
+      (((20 * c.col(5) * t + 12 * c.col(4)) * t + 6 * c.col(3)) * t + 2 * c.col(2)).cast<double>();
+}
+
+void AxisTrajectory::getState(double tick,
+                              std::vector<double> *position,
+                              std::vector<double> *velocity,
+                              std::vector<double> *acceleration)
+{
+  if (profile_ != NULL)
+  {
+    double s, ds, dds;
+    profile_->getState(tick, &s, &ds, &dds);
+    position->resize(axis_num_);
+    velocity->resize(axis_num_);
+    acceleration->resize(axis_num_);
+    for (uint8_t index = 0; index < axis_num_; index++)
+    {
+      (*position)[index] = start_position_[index] + distance_[index] * s;
+      (*velocity)[index] = distance_[index] * ds;
+      (*acceleration)[index] = distance_[index] * dds;
+    }
+    return;
+  }
+
+  const MatrixXr &c = power_coefficient_;
+  Real t = tick;
+
+  position->resize(axis_num_);
+  velocity->resize(axis_num_);
+  acceleration->resize(axis_num_);
+
+  // Horner with its derivatives carried along: three multiply-adds per power,
+  // evaluated axis by axis. Each step depends on the previous one.
+  for (uint8_t index = 0; index < axis_num_; index++)
+  {
+    Real p = c(index, 5);
+    Real v = 0.0;
+    Real a = 0.0;
+
+    for (int8_t power = 4; power >= 0; power--)
+    {
+      a = a * t + v;
+      v = v * t + p;
+      p = p * t + c(index, power);
+    }
+
+    (*position)[index] = p;
+    (*velocity)[index] = v;
+    (*acceleration)[index] = 2 * a;
+  }
+}
+
+MatrixXr AxisTrajectory::getCoefficient()
 {
   return coefficient_;
 }
 
+//-------------------- Joint trajectory --------------------//
+
+JointTrajectory::JointTrajectory(uint8_t joint_num) : AxisTrajectory(joint_num) {}
+
+JointTrajectory::~JointTrajectory() {}
+
 //-------------------- Task trajectory --------------------//
 
-TaskTrajectory::TaskTrajectory()
+TaskTrajectory::TaskTrajectory() : AxisTrajectory(3) {}
+
+TaskTrajectory::~TaskTrajectory() {}
+
+//-------------------- Via point trajectory --------------------//
+
+ViaPointTrajectory::ViaPointTrajectory(uint8_t joint_num)
 {
-  num_of_axis_ = 3;
-  coefficient_ = MatrixXf::Identity(6, num_of_axis_);
-  position_.reserve(num_of_axis_);
-  velocity_.reserve(num_of_axis_);
-  acceleration_.reserve(num_of_axis_);
+  joint_num_ = joint_num;
+  time_.assign(2, 0.0);
+  coefficient_ = MatrixXr::Zero(6, joint_num);
 }
 
-TaskTrajectory::~TaskTrajectory() {}
+ViaPointTrajectory::~ViaPointTrajectory() {}
 
-void TaskTrajectory::init(std::vector<Trajectory> start,
-                           std::vector<Trajectory> goal,
-                           double move_time,
-                           double control_time)
+bool ViaPointTrajectory::init(std::vector<Trajectory> start,
+                              const std::vector<std::vector<double> > &via_point,
+                              const std::vector<double> &via_time,
+                              double move_time)
 {
-  for (uint8_t index = 0; index < start.size(); index++)
+  size_t segment_num = via_point.size();
+  if (segment_num == 0 || start.size() != joint_num_ ||
+      (!via_time.empty() && via_time.size() != segment_num))
+    return false;
+
+  for (size_t index = 0; index < segment_num; index++)
   {
-    trajectory_generator_.calcCoefficient(start.at(index),
-                                    goal.at(index),
-                                    move_time,
-                                    control_time);
+    if (via_point[index].size() != joint_num_)
+      return false;
+  }
 
-    coefficient_.col(index) = trajectory_generator_.getCoefficient();
+  // Knot times
+  time_.resize(segment_num + 1);
+  time_[0] = 0.0;
+  if (via_time.empty())
+  {
+    std::vector<double> distance(segment_num);
+    double total_distance = 0.0;
+    for (size_t index = 0; index < segment_num; index++)
+    {
+      distance[index] = 0.0;
+      for (uint8_t joint = 0; joint < joint_num_; joint++)
+      {
+        double from = (index == 0) ? start[joint].position : via_point[index - 1][joint];
+        distance[index] = std::max(distance[index], fabs(via_point[index][joint] - from));
+      }
+      total_distance += distance[index];
+    }
+
+    // Repeated points still get a short segment so every knot interval is positive
+    double minimum = (total_distance > 0.0) ? 0.01 * total_distance / segment_num : 1.0;
+    total_distance = 0.0;
+    for (size_t index = 0; index < segment_num; index++)
+    {
+      distance[index] = std::max(distance[index], minimum);
+      total_distance += distance[index];
+    }
+    for (size_t index = 0; index < segment_num; index++)
+      time_[index + 1] = time_[index] + move_time * distance[index] / total_distance;
+  }
+  else
+  {
+    for (size_t index = 0; index < segment_num; index++)
+    {
+      if (via_time[index] <= time_[index])
+        return false;
+      time_[index + 1] = via_time[index];
+    }
   }
-}
 
-std::vector<double> TaskTrajectory::getPosition(double tick)
-{
-  position_.clear();
-  for (uint8_t index = 0; index < num_of_axis_; index++)
+  // Clamped spline: the knot accelerations M solve a tridiagonal system that only
+  // depends on the knot times, so one Thomas sweep solves every joint column.
+  size_t knot_num = segment_num + 1;
+  std::vector<Real> h(segment_num);
+  for (size_t index = 0; index < segment_num; index++)
+    h[index] = time_[index + 1] - time_[index];
+
+  MatrixXr y(knot_num, joint_num_);
+  Matrix<Real, 1, Dynamic> start_velocity(joint_num_);
+  for (uint8_t joint = 0; joint < joint_num_; joint++)
   {
-    double result = 0.0;
-    result = coefficient_(0, index) +
-             coefficient_(1, index) * pow(tick, 1) +
-             coefficient_(2, index) * pow(tick, 2) +
-             coefficient_(3, index) * pow(tick, 3) +
-             coefficient_(4, index) * pow(tick, 4) +
-             coefficient_(5, index) * pow(tick, 5);
+    y(0, joint) = start[joint].position;
+    start_velocity(joint) = start[joint].velocity;
+    for (size_t index = 0; index < segment_num; index++)
+      y(index + 1, joint) = via_point[index][joint];
+  }
+
+  std::vector<Real> sub(knot_num), diag(knot_num), sup(knot_num);
+  MatrixXr rhs(knot_num, joint_num_);
 
-    position_.push_back(result);
+  sub[0] = 0.0;
+  diag[0] = 2 * h[0];
+  sup[0] = h[0];
+  rhs.row(0) = 6 * ((y.row(1) - y.row(0)) / h[0] - start_velocity);
+  for (size_t index = 1; index < segment_num; index++)
+  {
+    sub[index] = h[index - 1];
+    diag[index] = 2 * (h[index - 1] + h[index]);
+    sup[index] = h[index];
+    rhs.row(index) = 6 * ((y.row(index + 1) - y.row(index)) / h[index] -
+                            (y.row(index) - y.row(index - 1)) / h[index - 1]);
+  }
+  sub[segment_num] = h[segment_num - 1];
+  diag[segment_num] = 2 * h[segment_num - 1];
+  sup[segment_num] = 0.0;
+  rhs.row(segment_num) = -6 * (y.row(segment_num) - y.row(segment_num - 1)) / h[segment_num - 1];
+
+  sup[0] /= diag[0];
+  rhs.row(0) /= diag[0];
+  for (size_t index = 1; index < knot_num; index++)
+  {
+    Real w = diag[index] - sub[index] * sup[index - 1];
+    sup[index] /= w;
+    rhs.row(index) = (rhs.row(index) - sub[index] * rhs.row(index - 1)) / w;
   }
+  for (size_t index = knot_num - 1; index-- > 0;)
+    rhs.row(index) -= sup[index] * rhs.row(index + 1);
 
-  return position_;
-}
+  const MatrixXr &M = rhs;
+  coefficient_ = MatrixXr::Zero(6 * segment_num, joint_num_);
+  for (size_t index = 0; index < segment_num; index++)
+  {
+    coefficient_.row(6 * index) = y.row(index);
+    coefficient_.row(6 * index + 1) = (y.row(index + 1) - y.row(index)) / h[index] -
+                                      h[index] * (2 * M.row(index) + M.row(index + 1)) / 6;
+    coefficient_.row(6 * index + 2) = M.row(index) / 2;
+    coefficient_.row(6 * index + 3) = (M.row(index + 1) - M.row(index)) / (6 * h[index]);
+  }
 
-std::vector<double> TaskTrajectory::getVelocity(double tick)
-{
-  velocity_.clear();
-  for (uint8_t index = 0; index < num_of_axis_; index++)
+  // The spline fixes the end velocities but not the end accelerations. The
+  // first and last segments become quintics that also start from the present
+  // acceleration and stop at rest, while matching the spline state at the
+  // inner knots so the path stays C2.
+  std::vector<Trajectory> from(joint_num_), to(joint_num_);
+  MatrixXr quintic;
+  size_t last = segment_num - 1;
+  for (uint8_t joint = 0; joint < joint_num_; joint++)
   {
-    double result = 0.0;
-    result = coefficient_(1, index) +
-             2 * coefficient_(2, index) * pow(tick, 1) +
-             3 * coefficient_(3, index) * pow(tick, 2) +
-             4 * coefficient_(4, index) * pow(tick, 3) +
-             5 * coefficient_(5, index) * pow(tick, 4);
+    from[joint] = start[joint];
+    to[joint].position = y(1, joint);
+    to[joint].velocity = coefficient_(1, joint) + h[0] * (2 * coefficient_(2, joint) + 3 * h[0] * coefficient_(3, joint));
+    to[joint].acceleration = M(1, joint);
+    if (segment_num == 1)
+    {
+      to[joint].velocity = 0.0;
+      to[joint].acceleration = 0.0;
+    }
+  }
+  // control_time = h keeps the segment time unrounded
+  MinimumJerk().calcCoefficient(from, to, h[0], h[0], &quintic);
+  coefficient_.middleRows(0, 6) = quintic;
 
-    velocity_.push_back(result);
+  if (segment_num > 1)
+  {
+    for (uint8_t joint = 0; joint < joint_num_; joint++)
+    {
+      from[joint].position = y(last, joint);
+      from[joint].velocity = coefficient_(6 * last + 1, joint);
+      from[joint].acceleration = M(last, joint);
+      to[joint].position = y(segment_num, joint);
+      to[joint].velocity = 0.0;
+      to[joint].acceleration = 0.0;
+    }
+    MinimumJerk().calcCoefficient(from, to, h[last], h[last], &quintic);
+    coefficient_.middleRows(6 * last, 6) = quintic;
   }
 
-  return velocity_;
+  return true;
 }
 
-std::vector<double> TaskTrajectory::getAcceleration(double tick)
+void ViaPointTrajectory::getState(double tick,
+                                  std::vector<double> *position,
+                                  std::vector<double> *velocity,
+                                  std::vector<double> *acceleration)
 {
-  acceleration_.clear();
-  for (uint8_t index = 0; index < num_of_axis_; index++)
+  size_t segment = std::upper_bound(time_.begin() + 1, time_.end() - 1, tick) - (time_.begin() + 1);
+  Real t = tick - time_[segment];
+
+  position->resize(joint_num_);
+  velocity->resize(joint_num_);
+  acceleration->resize(joint_num_);
+
+  for (uint8_t index = 0; index < joint_num_; index++)
   {
-    double result = 0.0;
+    Real p = coefficient_(6 * segment + 5, index);
+    Real v = 0.0;
+    Real a = 0.0;
+
+    for (int8_t power = 4; power >= 0; power--)
+    {
+      a = a * t + v;
+      v = v * t + p;
+      p = p * t + coefficient_(6 * segment + power, index);
+    }
+
+    (*position)[index] = p;
+    (*velocity)[index] = v;
+    (*acceleration)[index] = 2 * a;
+  }
+}
+
+double ViaPointTrajectory::getMoveTime()
+{
+  return time_.back();
+}
 
-    result = 2 * coefficient_(2, index) +
-             6 * coefficient_(3, index) * pow(tick, 1) +
-             12 * coefficient_(4, index) * pow(tick, 2) +
-             20 * coefficient_(5, index) * pow(tick, 3);
+std::vector<double> ViaPointTrajectory::getTime()
+{
+  return time_;
+}
+
+//-------------------- Streaming trajectory --------------------//
 
-    acceleration_.push_back(result);
+StreamingTrajectory::StreamingTrajectory(uint8_t joint_num)
+{
+  joint_num_ = joint_num;
+  target_.assign(joint_num, 0.0);
+  position_.assign(joint_num, 0.0);
+  velocity_.assign(joint_num, 0.0);
+  acceleration_.assign(joint_num, 0.0);
+  max_velocity_.assign(joint_num, DBL_MAX);
+  max_acceleration_.assign(joint_num, DBL_MAX);
+  max_jerk_.assign(joint_num, DBL_MAX);
+}
+
+StreamingTrajectory::~StreamingTrajectory() {}
+
+void StreamingTrajectory::init(std::vector<Trajectory> start)
+{
+  for (uint8_t index = 0; index < joint_num_; index++)
+  {
+    position_[index] = start.at(index).position;
+    velocity_[index] = start.at(index).velocity;
+    acceleration_[index] = start.at(index).acceleration;
+    target_[index] = start.at(index).position;
   }
+}
 
-  return acceleration_;
+void StreamingTrajectory::setLimit(const std::vector<double> &max_velocity,
+                                   const std::vector<double> &max_acceleration,
+                                   const std::vector<double> &max_jerk)
+{
+  for (uint8_t index = 0; index < joint_num_; index++)
+  {
+    max_velocity_[index] = max_velocity.at(index);
+    max_acceleration_[index] = max_acceleration.at(index);
+    max_jerk_[index] = max_jerk.at(index);
+  }
 }
 
-MatrixXf TaskTrajectory::getCoefficient()
+void StreamingTrajectory::setTarget(const std::vector<double> &target)
 {
-  return coefficient_;
+  for (uint8_t index = 0; index < joint_num_; index++)
+    target_[index] = target.at(index);
+}
+
+bool StreamingTrajectory::update(double control_time,
+                                 std::vector<double> *position,
+                                 std::vector<double> *velocity,
+                                 std::vector<double> *acceleration)
+{
+  double dt = control_time;
+  bool reached = true;
+
+  for (uint8_t index = 0; index < joint_num_; index++)
+  {
+    double &p = position_[index];
+    double &v = velocity_[index];
+    double &a = acceleration_[index];
+    // A joint without any finite limit follows its target directly
+    if (max_velocity_[index] >= DBL_MAX && max_acceleration_[index] >= DBL_MAX && max_jerk_[index] >= DBL_MAX)
+    {
+      p = target_[index];
+      v = 0.0;
+      a = 0.0;
+      continue;
+    }
+
+    // Unlimited quantities are capped, as in DoubleSProfile::initFastest(),
+    // so the finite limits still apply
+    double v_max = std::min(max_velocity_[index], 1e12);
+    double a_max = std::min(max_acceleration_[index], 1e12);
+    double j_max = std::min(max_jerk_[index], 1e12);
+
+    // Look at the state reached once the present acceleration is ramped to zero
+    double ramp_time = fabs(a) / j_max;
+    double ramp_velocity = v + 0.5 * a * ramp_time;
+    double error = target_[index] - (p + v * ramp_time + a * ramp_time * ramp_time / 3.0);
+
+    // Fastest velocity that still stops within the remaining distance with a
+    // jerk limited braking, d = v^2 / 2a + v a / 2j, with a small margin for the
+    // jerk ramp into braking. Without an acceleration limit the braking peaks at
+    // sqrt(v j), so d = v sqrt(v / j). Close to the target it turns linear so it settles.
+    bool acceleration_limit = (max_acceleration_[index] < DBL_MAX);
+    double peak_acceleration = acceleration_limit ? a_max : sqrt(fabs(ramp_velocity) * j_max);
+    double distance = std::max(fabs(error) - 0.25 * fabs(ramp_velocity) * peak_acceleration / j_max, 0.0);
+    double brake_velocity;
+    if (acceleration_limit)
+    {
+      double reach_velocity = a_max * a_max / j_max;
+      brake_velocity = 4.0 * a_max * distance /
+                       (reach_velocity + sqrt(reach_velocity * reach_velocity + 8.0 * a_max * distance));
+    }
+    else
+    {
+      brake_velocity = cbrt(distance * distance * j_max);
+    }
+    brake_velocity = std::min(brake_velocity, distance / (4.0 * dt));
+    double desired_velocity = copysign(std::min(v_max, brake_velocity), error);
+
+    double velocity_error = desired_velocity - ramp_velocity;
+    double desired_acceleration = copysign(std::min(std::min(a_max, sqrt(2.0 * j_max * fabs(velocity_error))),
+                                                    fabs(velocity_error) / (4.0 * dt)),
+                                           velocity_error);
+    double jerk = std::max(-j_max, std::min(j_max, (desired_acceleration - a) / dt));
+
+    p += v * dt + 0.5 * a * dt * dt + jerk * dt * dt * dt / 6.0;
+    v += a * dt + 0.5 * jerk * dt * dt;
+    a += jerk * dt;
+
+    if (fabs(target_[index] - p) < 1e-4 && fabs(v) < 1e-2 && fabs(a) < 0.5)
+    {
+      p = target_[index];
+      v = 0.0;
+      a = 0.0;
+    }
+    else
+    {
+      reached = false;
+    }
+  }
+
+  position->resize(joint_num_);
+  velocity->resize(joint_num_);
+  acceleration->resize(joint_num_);
+  for (uint8_t index = 0; index < joint_num_; index++)
+  {
+    (*position)[index] = position_[index];
+    (*velocity)[index] = velocity_[index];
+    (*acceleration)[index] = acceleration_[index];
+  }
+  return reached;
 }